@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <sstream>
+#include <random>
+#include "bson.h"
+#include "cbor.h"
+#include "intern.h"
+#include "json.h"
+#include "msgpack.h"
+#include "parser.h"
+#include "persistent.h"
+#include "rcu.h"
+#include "reclaim.h"
+#include "schema.h"
+#include "shared.h"
+#include "snapshot.h"
+#include "stats.h"
+
+// 生成 canada.json 风格的数据：一个多边形 Feature，坐标是大量 [经度, 纬度] 对
+static std::string make_canada_like(size_t npoints)
+{
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> lon(-141.0, -52.0), lat(41.0, 83.0);
+    JSONList ring;
+    ring.reserve(npoints);
+    for (size_t i = 0; i < npoints; i++)
+    {
+        ring.push_back(JSONObject{JSONList{JSONObject{lon(rng)}, JSONObject{lat(rng)}}});
+    }
+    JSONDict geometry;
+    geometry.try_emplace("type", JSONObject{std::string("Polygon")});
+    geometry.try_emplace("coordinates", JSONObject{JSONList{JSONObject{std::move(ring)}}});
+    JSONDict feature;
+    feature.try_emplace("type", JSONObject{std::string("Feature")});
+    feature.try_emplace("properties", JSONObject{JSONDict{{"name", JSONObject{std::string("Canada")}}}});
+    feature.try_emplace("geometry", JSONObject{std::move(geometry)});
+    JSONDict root;
+    root.try_emplace("type", JSONObject{std::string("FeatureCollection")});
+    root.try_emplace("features", JSONObject{JSONList{JSONObject{std::move(feature)}}});
+    return dump(JSONObject{std::move(root)});
+}
+
+// 字符串引用输入、字典平铺的解析策略
+struct ViewPolicy : DefaultParsePolicy
+{
+    using strings = StringViews;
+    using dict = FlatDict;
+};
+
+// 多次运行取最快的一次，返回秒数
+template <class F>
+static double best_of(int repeat, F &&f)
+{
+    double best = 1e300;
+    for (int r = 0; r < repeat; r++)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+static void collect_doubles(JSONObject const &obj, std::vector<double> &out)
+{
+    if (obj.is<double>())
+    {
+        out.push_back(obj.get<double>());
+    }
+    else if (obj.is<JSONList>())
+    {
+        for (auto const &v : obj.get<JSONList>())
+        {
+            collect_doubles(v, out);
+        }
+    }
+    else if (obj.is<JSONDict>())
+    {
+        for (auto const &[k, v] : obj.get<JSONDict>())
+        {
+            collect_doubles(v, out);
+        }
+    }
+}
+
+// 用法: bench [file.json]，不给文件时使用生成的 canada.json 风格数据
+int main(int argc, char **argv)
+{
+    std::string json;
+    if (argc > 1)
+    {
+        std::ifstream fin(argv[1], std::ios::binary);
+        if (!fin)
+        {
+            print("cannot open", argv[1]);
+            return 1;
+        }
+        std::stringstream ss;
+        ss << fin.rdbuf();
+        json = ss.str();
+    }
+    else
+    {
+        json = make_canada_like(111126);
+    }
+    double mb = json.size() / 1e6;
+    print("input:", mb, "MB");
+
+    JSONObject doc;
+    double t = best_of(5, [&]
+                       { doc = parse(json).first; });
+    double t_parse = t;
+    print("parse:", mb / t, "MB/s");
+
+    t = best_of(5, [&]
+                { doc = parse<RelaxedSyntax>(json).first; });
+    print("parse<RelaxedSyntax>:", mb / t, "MB/s");
+
+    {
+        basic_parser<> parser;
+        t = best_of(5, [&]
+                    { parser.parse(json); });
+        print("basic_parser<DefaultParsePolicy>:", mb / t, "MB/s");
+        basic_parser<ViewPolicy> view_parser;
+        t = best_of(5, [&]
+                    { view_parser.parse(json); });
+        print("basic_parser<ViewPolicy>:", mb / t, "MB/s");
+    }
+
+    {
+        // 整棵树从一块单调增长的内存里分配，释放时一次归还
+        t = best_of(5, [&]
+                    {
+                        std::pmr::monotonic_buffer_resource arena;
+                        AllocatorNodes<std::pmr::polymorphic_allocator<char>> nodes{&arena};
+                        parse(json, ParseOptions{}, nodes);
+                    });
+        print("parse (pmr monotonic arena):", mb / t, "MB/s");
+    }
+
+    Document reused;
+    t = best_of(5, [&]
+                { reused.parse(json); });
+    print("Document::parse (reused):", mb / t, "MB/s");
+
+    t = best_of(5, [&]
+                { validate(json); });
+    print("validate:", mb / t, "MB/s");
+
+    std::string pretty;
+    t = best_of(5, [&]
+                {
+                    pretty.clear();
+                    prettify(json, pretty);
+                });
+    print("prettify:", mb / t, "MB/s");
+    std::string mini;
+    t = best_of(5, [&]
+                {
+                    mini.clear();
+                    minify(pretty, mini);
+                });
+    print("minify (prettified input):", pretty.size() / 1e6 / t, "MB/s");
+#if BABYJSON_TRACE
+    trace_reset();
+    parse(json);
+    print("parse phases:");
+    trace_report();
+#endif
+#if BABYJSON_STATS
+    print("parse stats:", std::get<2>(parse_with_stats(json)));
+    print("Document::parse stats:", parse_with_stats(reused, json));
+#endif
+
+    // 只在没给文件时有意义：schema 描述的是生成的 canada.json 风格数据
+    if (argc <= 1)
+    {
+        SchemaCache schemas;
+        auto schema = schemas.get(R"({"type": "object", "required": ["type", "features"], "properties": {
+            "type": {"const": "FeatureCollection"},
+            "features": {"type": "array", "items": {"type": "object", "required": ["type", "geometry"], "properties": {
+                "type": {"type": "string"},
+                "properties": {"type": "object"},
+                "geometry": {"type": "object", "required": ["type", "coordinates"], "properties": {
+                    "type": {"type": "string"},
+                    "coordinates": {"type": "array", "items": {"type": "array", "items": {
+                        "type": "array", "minItems": 2, "maxItems": 2,
+                        "prefixItems": [{"type": "number", "minimum": -180, "maximum": 180},
+                                        {"type": "number", "minimum": -90, "maximum": 90}]}}}}}}}}}})");
+        SchemaError res;
+        t = best_of(5, [&]
+                    { res = schema->validate(doc); });
+        print("schema validate (parsed):", mb / t, "MB/s", res);
+        t = best_of(5, [&]
+                    { res = schema->validate_json(json); });
+        print("schema validate_json (streaming):", mb / t, "MB/s", res);
+    }
+
+    std::string out;
+    t = best_of(5, [&]
+                {
+                    out.clear();
+                    dump(doc, out);
+                });
+    print("dump:", out.size() / 1e6 / t, "MB/s");
+
+    // 二进制格式：编码按输出字节数算吞吐，解码和文本 parse 比同一棵树花的时间
+    std::string packed;
+    t = best_of(5, [&]
+                {
+                    packed.clear();
+                    msgpack_encode(doc, packed);
+                });
+    print("msgpack encode:", packed.size() / 1e6 / t, "MB/s,", packed.size() / 1e6, "MB");
+    t = best_of(5, [&]
+                { doc = msgpack_decode(packed).first; });
+    print("msgpack decode:", packed.size() / 1e6 / t, "MB/s,", t_parse / t, "x parse");
+    t = best_of(5, [&]
+                {
+                    packed.clear();
+                    cbor_encode(doc, packed);
+                });
+    print("cbor encode:", packed.size() / 1e6 / t, "MB/s,", packed.size() / 1e6, "MB");
+    t = best_of(5, [&]
+                { doc = cbor_decode(packed).first; });
+    print("cbor decode:", packed.size() / 1e6 / t, "MB/s,", t_parse / t, "x parse");
+
+    if (doc.is<JSONDict>())
+    {
+        t = best_of(5, [&]
+                    {
+                        packed.clear();
+                        bson_encode(doc, packed);
+                    });
+        print("bson encode:", packed.size() / 1e6 / t, "MB/s,", packed.size() / 1e6, "MB");
+        t = best_of(5, [&]
+                    { doc = bson_decode(packed).first; });
+        print("bson decode:", packed.size() / 1e6 / t, "MB/s,", t_parse / t, "x parse");
+        // 按需取一个字段，只跳过其余元素
+        size_t found = 0;
+        t = best_of(5, [&]
+                    {
+                        auto view = bson_view(packed);
+                        found = view && view->find("type") ? view->find("type")->size() : 0;
+                    });
+        print("bson_view find(\"type\"):", t * 1e6, "us,", found, "bytes");
+    }
+
+    // 快照：open 只 mmap 并检查文件头，和文档大小无关
+    std::string image;
+    t = best_of(5, [&]
+                {
+                    image.clear();
+                    snapshot_write(doc, image);
+                });
+    print("snapshot write:", image.size() / 1e6 / t, "MB/s,", image.size() / 1e6, "MB");
+    std::string snap_path = (std::filesystem::temp_directory_path() / "babyjson_bench.snapshot").string();
+    if (snapshot_save(doc, snap_path))
+    {
+        std::shared_ptr<Snapshot const> snap;
+        t = best_of(5, [&]
+                    { snap = Snapshot::open(snap_path); });
+        print("snapshot open:", t * 1e6, "us,", t_parse / t, "x parse");
+        t = best_of(5, [&]
+                    { snap->check(); });
+        print("snapshot check:", image.size() / 1e6 / t, "MB/s");
+        t = best_of(5, [&]
+                    { doc = snap->root().to_object(); });
+        print("snapshot to_object:", image.size() / 1e6 / t, "MB/s");
+        snap.reset();
+        std::filesystem::remove(snap_path);
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    {
+        // 共享内存：发布要写一遍镜像，读者换版本只是 shm_open 加 mmap
+        std::string name = "/babyjson-bench";
+        t = best_of(5, [&]
+                    { shared_publish(name, doc); });
+        print("shared_publish:", image.size() / 1e6 / t, "MB/s");
+        t = best_of(5, [&]
+                    { SharedDocument::open(name)->current(); });
+        print("SharedDocument open + current:", t * 1e6, "us");
+        auto shared = SharedDocument::open(name);
+        t = best_of(5, [&]
+                    { shared->current(); });
+        print("SharedDocument::current (unchanged):", t * 1e9, "ns");
+        shared_remove(name);
+    }
+#endif
+
+    {
+        // 持久化树：复制只加引用计数，修改只复制路径上的节点
+        PersistentJSON pdoc;
+        t = best_of(5, [&]
+                    { pdoc = PersistentJSON(doc); });
+        print("PersistentJSON from JSONObject:", mb / t, "MB/s");
+        JSONObject copy;
+        t = best_of(5, [&]
+                    { copy = doc; });
+        print("JSONObject copy:", t * 1e6, "us");
+        PersistentJSON pcopy;
+        t = best_of(5, [&]
+                    { pcopy = pdoc; });
+        print("PersistentJSON copy:", t * 1e9, "ns");
+        t = best_of(5, [&]
+                    { pcopy = *pdoc.set_pointer("/features/0/properties/name", PersistentJSON(JSONObject{std::string("Canada 2")})); });
+        print("PersistentJSON set_pointer:", t * 1e9, "ns");
+        t = best_of(5, [&]
+                    { pcopy == pdoc; });
+        print("PersistentJSON compare versions:", t * 1e9, "ns");
+    }
+
+    {
+        // RCU：读者只做两次原子加减，发布时等旧纪元的读者离开再释放旧版本
+        RcuDocument shared(doc);
+        size_t found = 0;
+        t = best_of(5, [&]
+                    {
+                        for (int i = 0; i < 1000; i++)
+                        {
+                            auto cur = shared.read();
+                            found += cur->get<JSONDict>().count("type");
+                        }
+                    });
+        print("RcuDocument read + find:", t * 1e6, "ns,", found > 0);
+        t = best_of(5, [&]
+                    { shared.publish(JSONObject{std::nullptr_t{}}); });
+        print("RcuDocument publish (no readers):", t * 1e6, "us");
+    }
+
+    {
+        // 哈希合并：canada 的坐标几乎不重复，是最坏情况；再拿一份由少数几种对象反复组成的目录比较
+        JSONInterner interner;
+        t = best_of(1, [&]
+                    { interner.intern(doc); });
+        print("JSONInterner intern:", mb / t, "MB/s,", interner.size(), "distinct nodes,", interner.hits(), "hits");
+        JSONList items;
+        for (int i = 0; i < 100000; i++)
+        {
+            items.push_back(JSONObject{JSONDict{{"id", JSONObject{i}},
+                                                {"vendor", JSONObject{JSONDict{{"name", JSONObject{std::string("ACME Corporation")}},
+                                                                               {"country", JSONObject{std::string("Canada")}}}}},
+                                                {"tags", JSONObject{JSONList{JSONObject{std::string("tools")}, JSONObject{std::string("hardware")}}}},
+                                                {"price", JSONObject{double(i % 7) + 0.99}}}});
+        }
+        JSONObject catalogue{std::move(items)};
+        double catalogue_mb = dump(catalogue).size() / 1e6;
+        JSONInterner catalogue_interner;
+        t = best_of(1, [&]
+                    { catalogue_interner.intern(catalogue); });
+        print("JSONInterner intern (catalogue):", catalogue_mb / t, "MB/s,", catalogue_interner.size(), "distinct nodes,",
+              catalogue_interner.hits(), "hits");
+    }
+
+    {
+        // 释放大树：默认析构、不递归的 destroy、交给后台线程；每次先复制一份再计时
+        auto time_release = [&](auto &&release)
+        {
+            double best = 1e300;
+            for (int r = 0; r < 5; r++)
+            {
+                JSONObject victim = doc;
+                best = std::min(best, best_of(1, [&]
+                                              { release(victim); }));
+            }
+            return best;
+        };
+        t = time_release([](JSONObject &obj)
+                         { obj = JSONObject{}; });
+        print("~JSONObject:", t * 1e3, "ms");
+        t = time_release([](JSONObject &obj)
+                         { destroy(std::move(obj)); });
+        print("destroy:", t * 1e3, "ms");
+        Reclaimer reclaimer;
+        t = time_release([&](JSONObject &obj)
+                         { reclaimer.reclaim(std::move(obj)); });
+        print("Reclaimer::reclaim:", t * 1e6, "us");
+    }
+
+    std::vector<double> nums;
+    collect_doubles(doc, nums);
+    if (!nums.empty())
+    {
+        char buf[32];
+        volatile size_t sink = 0;
+        t = best_of(5, [&]
+                    {
+                        for (double d : nums)
+                        {
+                            sink = sink + double_to_chars(d, buf);
+                        }
+                    });
+        print("double_to_chars:", t * 1e9 / nums.size(), "ns/number");
+        t = best_of(5, [&]
+                    {
+                        for (double d : nums)
+                        {
+                            sink = sink + std::snprintf(buf, sizeof(buf), "%.17g", d);
+                        }
+                    });
+        print("snprintf %.17g:", t * 1e9 / nums.size(), "ns/number");
+
+        std::vector<double> back;
+        collect_doubles(parse(out).first, back);
+        // 字典遍历顺序不固定，排序后再逐个比较
+        std::vector<double> sorted = nums;
+        std::sort(sorted.begin(), sorted.end());
+        std::sort(back.begin(), back.end());
+        size_t mismatches = back.size() == sorted.size() ? 0 : sorted.size();
+        for (size_t i = 0; i < back.size() && i < sorted.size(); i++)
+        {
+            mismatches += back[i] != sorted[i];
+        }
+        print("round-trip mismatches:", mismatches, "of", nums.size());
+    }
+    return 0;
+}
@@ -0,0 +1,581 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include "json.h"
+
+// JSONObject 和 BSON 互转，见 https://bsonspec.org/spec.html
+// 编码一遍写完：文档先占 4 字节长度，写完内容后回填；int 写成 int32，double 写成 double
+// 解码既可以用 bson_decode 整个还原，也可以用 bson_view 拿到 BsonValue 按需查字段，查找时只跳过不需要的元素，不建树
+// BSON 的顶层只能是文档，键里不能有 '\0'；ObjectId、日期等没有对应 JSONObject 的类型查找时可以跳过，还原时视为错误
+
+namespace _bson_details {
+    constexpr unsigned char type_double = 0x01;
+    constexpr unsigned char type_string = 0x02;
+    constexpr unsigned char type_document = 0x03;
+    constexpr unsigned char type_array = 0x04;
+    constexpr unsigned char type_bool = 0x08;
+    constexpr unsigned char type_null = 0x0A;
+    constexpr unsigned char type_int32 = 0x10;
+    constexpr unsigned char type_int64 = 0x12;
+
+    inline void put_le(std::string &out, uint64_t v, size_t n)
+    {
+        char buf[8];
+        for (size_t i = 0; i < n; i++)
+        {
+            buf[i] = char(v >> (8 * i));
+        }
+        out.append(buf, n);
+    }
+
+    inline uint64_t get_le(char const *p, size_t n)
+    {
+        uint64_t v = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            v |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+        }
+        return v;
+    }
+
+    inline int32_t get_int32(char const *p)
+    {
+        return int32_t(uint32_t(get_le(p, 4)));
+    }
+
+    struct _encoder
+    {
+        std::string &out;
+
+        // 写元素头：类型、以 '\0' 结尾的键
+        bool element(unsigned char type, std::string_view name)
+        {
+            if (name.find('\0') != std::string_view::npos)
+            {
+                return false;
+            }
+            out += char(type);
+            out += name;
+            out += '\0';
+            return true;
+        }
+
+        // 先占位长度，写完内容再回填
+        template <class F>
+        bool document(F &&items)
+        {
+            size_t at = out.size();
+            out.append(4, '\0');
+            if (!items())
+            {
+                return false;
+            }
+            out += '\0';
+            size_t len = out.size() - at;
+            if (len > size_t(INT32_MAX))
+            {
+                return false;
+            }
+            for (size_t i = 0; i < 4; i++)
+            {
+                out[at + i] = char(len >> (8 * i));
+            }
+            return true;
+        }
+
+        bool dict(JSONDict const &dict)
+        {
+            return document([&]
+                            {
+                                for (auto const &[k, v] : dict)
+                                {
+                                    if (!value(k, v))
+                                    {
+                                        return false;
+                                    }
+                                }
+                                return true;
+                            });
+        }
+
+        bool value(std::string_view name, JSONObject const &obj)
+        {
+            return std::visit(
+                overloaded{
+                    [&](std::nullptr_t)
+                    {
+                        return element(type_null, name);
+                    },
+                    [&](bool val)
+                    {
+                        if (!element(type_bool, name))
+                        {
+                            return false;
+                        }
+                        out += char(val);
+                        return true;
+                    },
+                    [&](int val)
+                    {
+                        if (!element(type_int32, name))
+                        {
+                            return false;
+                        }
+                        put_le(out, uint32_t(val), 4);
+                        return true;
+                    },
+                    [&](double val)
+                    {
+                        if (!element(type_double, name))
+                        {
+                            return false;
+                        }
+                        uint64_t bits;
+                        std::memcpy(&bits, &val, 8);
+                        put_le(out, bits, 8);
+                        return true;
+                    },
+                    [&](std::string const &val)
+                    {
+                        if (!element(type_string, name) || val.size() >= size_t(INT32_MAX))
+                        {
+                            return false;
+                        }
+                        put_le(out, val.size() + 1, 4);
+                        out += val;
+                        out += '\0';
+                        return true;
+                    },
+                    [&](JSONList const &val)
+                    {
+                        // 数组就是键为 "0"、"1"、... 的文档
+                        return element(type_array, name) &&
+                               document([&]
+                                        {
+                                            char key[24];
+                                            for (size_t i = 0; i < val.size(); i++)
+                                            {
+                                                auto end = std::to_chars(key, key + sizeof(key), i).ptr;
+                                                if (!value(std::string_view(key, end - key), val[i]))
+                                                {
+                                                    return false;
+                                                }
+                                            }
+                                            return true;
+                                        });
+                    },
+                    [&](JSONDict const &val)
+                    {
+                        return element(type_document, name) && dict(val);
+                    },
+                },
+                obj.inner);
+        }
+    };
+
+    // 算出 data 开头一个 type 类型的值占多少字节，数据不完整或格式不对时返回 nullopt
+    inline std::optional<size_t> value_size(unsigned char type, std::string_view data)
+    {
+        auto fixed = [&](size_t n) -> std::optional<size_t>
+        {
+            return data.size() >= n ? std::optional<size_t>(n) : std::nullopt;
+        };
+        // 以 int32 长度开头的值，返回长度字段的值，不小于 min 且后面还有 rest 字节可用时才算合法
+        auto length = [&](int32_t min, size_t rest) -> std::optional<size_t>
+        {
+            if (data.size() < 4)
+            {
+                return std::nullopt;
+            }
+            int32_t len = get_int32(data.data());
+            return len >= min && size_t(len) <= rest ? std::optional<size_t>(size_t(len)) : std::nullopt;
+        };
+        auto cstring = [&](size_t from) -> std::optional<size_t>
+        {
+            size_t end = data.find('\0', from);
+            return end == std::string_view::npos ? std::nullopt : std::optional<size_t>(end + 1);
+        };
+        switch (type)
+        {
+        case type_double:
+        case 0x09: // UTC datetime
+        case 0x11: // timestamp
+        case type_int64:
+            return fixed(8);
+        case type_int32:
+            return fixed(4);
+        case type_bool:
+            return fixed(1);
+        case type_null:
+        case 0x06: // undefined
+        case 0x7F: // max key
+        case 0xFF: // min key
+            return 0;
+        case 0x07: // ObjectId
+            return fixed(12);
+        case 0x13: // decimal128
+            return fixed(16);
+        case type_string:
+        case 0x0D: // JavaScript code
+        case 0x0E: // symbol
+        {
+            // 长度包括结尾的 '\0'
+            auto n = data.size() >= 4 ? length(1, data.size() - 4) : std::nullopt;
+            return n && data[4 + *n - 1] == '\0' ? std::optional<size_t>(4 + *n) : std::nullopt;
+        }
+        case type_document:
+        case type_array:
+        case 0x0F: // code with scope
+        {
+            // 长度包括自身的 4 字节和结尾的 '\0'
+            auto n = length(5, data.size());
+            return n && data[*n - 1] == '\0' ? n : std::nullopt;
+        }
+        case 0x05: // binary：长度、子类型、内容
+        {
+            auto n = data.size() >= 5 ? length(0, data.size() - 5) : std::nullopt;
+            return n ? std::optional<size_t>(5 + *n) : std::nullopt;
+        }
+        case 0x0B: // 正则：两个 cstring
+        {
+            auto first = cstring(0);
+            return first ? cstring(*first) : std::nullopt;
+        }
+        case 0x0C: // DBPointer：字符串加 12 字节
+        {
+            auto n = value_size(type_string, data);
+            return n && data.size() - *n >= 12 ? std::optional<size_t>(*n + 12) : std::nullopt;
+        }
+        default:
+            return std::nullopt;
+        }
+    }
+}
+
+// BSON 里的一个值，只引用输入的字节，复制很便宜；输入必须比它活得久
+// 类型判断用 is<T>()，T 和 JSONObject 一样取 std::nullptr_t、bool、int、double、std::string、JSONList、JSONDict；
+// int64 在 int 范围内算 int，否则算 double，和 parse 对大整数的处理一致；没有对应类型时 index() 为 std::variant_npos
+class BsonValue
+{
+public:
+    BsonValue(unsigned char type, std::string_view data) : type(type), data(data)
+    {
+    }
+
+    // BSON 的类型字节
+    unsigned char bson_type() const
+    {
+        return type;
+    }
+
+    size_t index() const
+    {
+        using namespace _bson_details;
+        switch (type)
+        {
+        case type_null:
+            return json_index<std::nullptr_t>;
+        case type_bool:
+            return json_index<bool>;
+        case type_int32:
+            return json_index<int>;
+        case type_int64:
+        {
+            int64_t v = int64_t(get_le(data.data(), 8));
+            return INT32_MIN <= v && v <= INT32_MAX ? json_index<int> : json_index<double>;
+        }
+        case type_double:
+            return json_index<double>;
+        case type_string:
+            return json_index<std::string>;
+        case type_array:
+            return json_index<JSONList>;
+        case type_document:
+            return json_index<JSONDict>;
+        default:
+            return std::variant_npos;
+        }
+    }
+
+    template <class T>
+    bool is() const
+    {
+        return index() == json_index<T>;
+    }
+
+    bool as_bool() const
+    {
+        return data[0] != 0;
+    }
+
+    int as_int() const
+    {
+        return type == _bson_details::type_int64 ? int(int64_t(_bson_details::get_le(data.data(), 8)))
+                                                 : int(_bson_details::get_int32(data.data()));
+    }
+
+    double as_double() const
+    {
+        if (type == _bson_details::type_int64)
+        {
+            return double(int64_t(_bson_details::get_le(data.data(), 8)));
+        }
+        uint64_t bits = _bson_details::get_le(data.data(), 8);
+        double val;
+        std::memcpy(&val, &bits, 8);
+        return val;
+    }
+
+    // 指向输入内部，不含结尾的 '\0'
+    std::string_view as_string() const
+    {
+        return data.substr(4, data.size() - 5);
+    }
+
+    // 按顺序遍历文档或数组的元素，f(key, value) 返回 false 时停止；不是文档或数组、元素格式不对时返回 false
+    template <class F>
+    bool for_each(F &&f) const
+    {
+        if (type != _bson_details::type_document && type != _bson_details::type_array)
+        {
+            return false;
+        }
+        std::string_view rest = data.substr(4, data.size() - 5);
+        while (!rest.empty())
+        {
+            unsigned char t = rest[0];
+            size_t name_end = rest.find('\0', 1);
+            if (name_end == std::string_view::npos)
+            {
+                return false;
+            }
+            std::string_view name = rest.substr(1, name_end - 1);
+            rest.remove_prefix(name_end + 1);
+            auto n = _bson_details::value_size(t, rest);
+            if (!n)
+            {
+                return false;
+            }
+            if (!f(name, BsonValue(t, rest.substr(0, *n))))
+            {
+                return true;
+            }
+            rest.remove_prefix(*n);
+        }
+        return true;
+    }
+
+    // 文档或数组的元素个数，字符串的字节数；元素格式不对时返回已经数到的个数
+    size_t size() const
+    {
+        if (type == _bson_details::type_string)
+        {
+            return as_string().size();
+        }
+        size_t n = 0;
+        for_each([&](std::string_view, BsonValue)
+                 {
+                     n++;
+                     return true;
+                 });
+        return n;
+    }
+
+    // 在文档里按键查找，跳过前面的元素；有重复的键时取第一个
+    std::optional<BsonValue> find(std::string_view key) const
+    {
+        std::optional<BsonValue> res;
+        for_each([&](std::string_view name, BsonValue val)
+                 {
+                     if (name == key)
+                     {
+                         res = val;
+                         return false;
+                     }
+                     return true;
+                 });
+        return res;
+    }
+
+    // 数组的第 i 个元素，按位置数，不看键
+    std::optional<BsonValue> at(size_t i) const
+    {
+        std::optional<BsonValue> res;
+        for_each([&](std::string_view, BsonValue val)
+                 {
+                     if (i-- == 0)
+                     {
+                         res = val;
+                         return false;
+                     }
+                     return true;
+                 });
+        return res;
+    }
+
+    std::string_view bytes() const
+    {
+        return data;
+    }
+
+private:
+    unsigned char type;
+    std::string_view data; // 值本身的字节，不含类型和键
+};
+
+namespace _bson_details {
+    struct _decoder
+    {
+        ParseOptions const &opts;
+        ParseState state;
+
+        bool value(BsonValue val, JSONObject &out)
+        {
+            if (++state.nodes > opts.max_nodes)
+            {
+                return false;
+            }
+            switch (val.bson_type())
+            {
+            case type_null:
+                out = JSONObject{std::nullptr_t{}};
+                return true;
+            case type_bool:
+                out = JSONObject{val.as_bool()};
+                return true;
+            case type_int32:
+            case type_int64:
+            case type_double:
+                out = val.is<int>() ? JSONObject{val.as_int()} : JSONObject{val.as_double()};
+                return true;
+            case type_string:
+            {
+                std::string_view str = val.as_string();
+                if (!string(str))
+                {
+                    return false;
+                }
+                out = JSONObject{std::string(str)};
+                return true;
+            }
+            case type_array:
+                return list(val, out);
+            case type_document:
+                return dict(val, out);
+            default:
+                return false;
+            }
+        }
+
+        bool string(std::string_view str)
+        {
+            return str.size() <= opts.max_string_length && (!opts.validate_utf8 || utf8_validate(str));
+        }
+
+        bool list(BsonValue val, JSONObject &out)
+        {
+            if (++state.depth > opts.max_depth)
+            {
+                return false;
+            }
+            JSONList res;
+            bool ok = true;
+            // 数组的键按规范应为 "0"、"1"、...，这里只看顺序
+            bool complete = val.for_each([&](std::string_view, BsonValue item)
+                                         {
+                                             ok = res.size() < opts.max_elements && value(item, res.emplace_back());
+                                             return ok;
+                                         });
+            if (!ok || !complete)
+            {
+                return false;
+            }
+            state.depth--;
+            out = JSONObject{std::move(res)};
+            return true;
+        }
+
+        bool dict(BsonValue val, JSONObject &out)
+        {
+            if (++state.depth > opts.max_depth)
+            {
+                return false;
+            }
+            JSONDict res;
+            size_t count = 0;
+            bool ok = true;
+            bool complete = val.for_each([&](std::string_view name, BsonValue item)
+                                         {
+                                             JSONObject v;
+                                             ok = count++ < opts.max_elements && string(name) && value(item, v);
+                                             if (ok)
+                                             {
+                                                 res.try_emplace(std::string(name), std::move(v));
+                                             }
+                                             return ok;
+                                         });
+            if (!ok || !complete)
+            {
+                return false;
+            }
+            state.depth--;
+            out = JSONObject{std::move(res)};
+            return true;
+        }
+    };
+}
+
+// 把字典 obj 编码成一个 BSON 文档追加到 out；obj 不是字典、键里有 '\0' 或文档超过 2GB 时返回 false，out 保持原样
+inline bool bson_encode(JSONObject const &obj, std::string &out)
+{
+    size_t old_size = out.size();
+    _bson_details::_encoder encoder{out};
+    if (!obj.is<JSONDict>() || !encoder.dict(obj.get<JSONDict>()))
+    {
+        out.resize(old_size);
+        return false;
+    }
+    return true;
+}
+
+// 取 data 开头的一个 BSON 文档，只检查外层的长度和结尾，字段在访问时才解析
+inline std::optional<BsonValue> bson_view(std::string_view data)
+{
+    auto n = _bson_details::value_size(_bson_details::type_document, data);
+    if (!n)
+    {
+        return std::nullopt;
+    }
+    return BsonValue(_bson_details::type_document, data.substr(0, *n));
+}
+
+// 整个还原 data 开头的一个 BSON 文档，返回值和吃掉的字节数，失败返回 0；opts 里的限制同样生效
+inline std::pair<JSONObject, size_t> bson_decode(std::string_view data, ParseOptions const &opts = {})
+{
+    auto doc = bson_view(data);
+    _bson_details::_decoder dec{opts, {}};
+    JSONObject res;
+    if (!doc || !dec.value(*doc, res))
+    {
+        return {JSONObject{std::nullptr_t{}}, 0};
+    }
+    return {std::move(res), doc->bytes().size()};
+}
+
+// 把 BSON 里的一个值还原成 JSONObject，比如 bson_view 后 find 到的子文档
+inline std::optional<JSONObject> bson_to_object(BsonValue val, ParseOptions const &opts = {})
+{
+    _bson_details::_decoder dec{opts, {}};
+    JSONObject res;
+    if (!dec.value(val, res))
+    {
+        return std::nullopt;
+    }
+    return res;
+}
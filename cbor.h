@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "json.h"
+
+// JSONObject 和 CBOR（RFC 8949）互转
+// 编码时长度和整数取最短的形式，double 一律写成 float64；解码时接受半精度、单精度浮点数和不定长的字符串、数组、映射，
+// 忽略标签只取被标记的值，undefined 当作 null；字节串和非字符串的键没有对应的 JSONObject，视为错误
+
+namespace _cbor_details {
+    constexpr unsigned char major_uint = 0;
+    constexpr unsigned char major_negative = 1;
+    constexpr unsigned char major_bytes = 2;
+    constexpr unsigned char major_text = 3;
+    constexpr unsigned char major_array = 4;
+    constexpr unsigned char major_map = 5;
+    constexpr unsigned char major_tag = 6;
+    constexpr unsigned char major_simple = 7;
+    constexpr unsigned char indefinite = 31;
+    constexpr unsigned char break_byte = 0xFF;
+
+    // 写出类型头：major 占高 3 位，参数 n 小于 24 时直接放进低 5 位，否则后跟 1、2、4、8 字节的大端整数
+    inline void put_head(std::string &out, unsigned char major, uint64_t n)
+    {
+        unsigned char m = major << 5;
+        if (n < 24)
+        {
+            out += char(m | n);
+            return;
+        }
+        size_t len = n <= 0xFF ? 1 : n <= 0xFFFF ? 2 : n <= 0xFFFFFFFF ? 4 : 8;
+        char buf[9];
+        buf[0] = char(m | (len == 1 ? 24 : len == 2 ? 25 : len == 4 ? 26 : 27));
+        for (size_t i = 0; i < len; i++)
+        {
+            buf[1 + i] = char(n >> (8 * (len - 1 - i)));
+        }
+        out.append(buf, 1 + len);
+    }
+
+    inline void encode(JSONObject const &obj, std::string &out)
+    {
+        std::visit(
+            overloaded{
+                [&](std::nullptr_t)
+                {
+                    out += char(0xF6);
+                },
+                [&](bool val)
+                {
+                    out += char(val ? 0xF5 : 0xF4);
+                },
+                [&](int val)
+                {
+                    // 负数 -1 - n 编码为 n
+                    if (val >= 0)
+                    {
+                        put_head(out, major_uint, uint64_t(val));
+                    }
+                    else
+                    {
+                        put_head(out, major_negative, uint64_t(-1 - int64_t(val)));
+                    }
+                },
+                [&](double val)
+                {
+                    uint64_t bits;
+                    std::memcpy(&bits, &val, 8);
+                    char buf[9] = {char(0xFB)};
+                    for (size_t i = 0; i < 8; i++)
+                    {
+                        buf[1 + i] = char(bits >> (8 * (7 - i)));
+                    }
+                    out.append(buf, 9);
+                },
+                [&](std::string const &val)
+                {
+                    put_head(out, major_text, val.size());
+                    out += val;
+                },
+                [&](JSONList const &val)
+                {
+                    put_head(out, major_array, val.size());
+                    for (auto const &v : val)
+                    {
+                        encode(v, out);
+                    }
+                },
+                [&](JSONDict const &val)
+                {
+                    put_head(out, major_map, val.size());
+                    for (auto const &[k, v] : val)
+                    {
+                        put_head(out, major_text, k.size());
+                        out += k;
+                        encode(v, out);
+                    }
+                },
+            },
+            obj.inner);
+    }
+
+    inline double half_to_double(uint16_t h)
+    {
+        int exp = (h >> 10) & 0x1F;
+        int mant = h & 0x3FF;
+        double val;
+        if (exp == 0)
+        {
+            val = std::ldexp(mant, -24);
+        }
+        else if (exp != 31)
+        {
+            val = std::ldexp(mant + 1024, exp - 25);
+        }
+        else
+        {
+            val = mant == 0 ? HUGE_VAL : NAN;
+        }
+        return h & 0x8000 ? -val : val;
+    }
+
+    struct _decoder
+    {
+        unsigned char const *p;
+        unsigned char const *end;
+        ParseOptions const &opts;
+        ParseState state;
+
+        bool need(size_t n) const
+        {
+            return size_t(end - p) >= n;
+        }
+
+        // 读出类型头，info 为低 5 位，arg 为其表示的参数；不定长时 info 为 indefinite
+        bool head(unsigned char &major, unsigned char &info, uint64_t &arg)
+        {
+            if (!need(1))
+            {
+                return false;
+            }
+            major = *p >> 5;
+            info = *p & 0x1F;
+            p++;
+            if (info < 24 || info == indefinite)
+            {
+                arg = info;
+                return true;
+            }
+            if (info > 27)
+            {
+                return false;
+            }
+            size_t len = size_t(1) << (info - 24);
+            if (!need(len))
+            {
+                return false;
+            }
+            arg = 0;
+            for (size_t i = 0; i < len; i++)
+            {
+                arg = (arg << 8) | p[i];
+            }
+            p += len;
+            return true;
+        }
+
+        bool is_break()
+        {
+            if (need(1) && *p == break_byte)
+            {
+                p++;
+                return true;
+            }
+            return false;
+        }
+
+        // 把一段定长文本直接从输入拷进 str
+        bool append_text(uint64_t n, std::string &str)
+        {
+            if (!need(n) || str.size() + n > opts.max_string_length)
+            {
+                return false;
+            }
+            if (opts.validate_utf8 && !utf8_validate(reinterpret_cast<char const *>(p), n))
+            {
+                return false;
+            }
+            str.append(reinterpret_cast<char const *>(p), n);
+            p += n;
+            return true;
+        }
+
+        // 不定长文本由若干定长文本片段组成，以 break 结束
+        bool text(unsigned char info, uint64_t arg, std::string &str)
+        {
+            str.clear();
+            if (info != indefinite)
+            {
+                return append_text(arg, str);
+            }
+            while (!is_break())
+            {
+                unsigned char major, chunk_info;
+                if (!head(major, chunk_info, arg) || major != major_text || chunk_info == indefinite || !append_text(arg, str))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static JSONObject from_int(uint64_t n, bool negative)
+        {
+            // 和 parse 一样，超出 int 的整数存为 double
+            if (!negative && n <= uint64_t(INT32_MAX))
+            {
+                return JSONObject{int(n)};
+            }
+            if (negative && n <= uint64_t(INT32_MAX))
+            {
+                return JSONObject{int(-1 - int64_t(n))};
+            }
+            return JSONObject{negative ? -1.0 - double(n) : double(n)};
+        }
+
+        bool value(JSONObject &out)
+        {
+            unsigned char major, info;
+            uint64_t arg;
+            if (!head(major, info, arg))
+            {
+                return false;
+            }
+            // 标签不计入节点数，直接跳过；连续的标签在这里循环，不递归
+            while (major == major_tag)
+            {
+                if (info == indefinite || !head(major, info, arg))
+                {
+                    return false;
+                }
+            }
+            if (++state.nodes > opts.max_nodes)
+            {
+                return false;
+            }
+            switch (major)
+            {
+            case major_uint:
+            case major_negative:
+                if (info == indefinite)
+                {
+                    return false;
+                }
+                out = from_int(arg, major == major_negative);
+                return true;
+            case major_text:
+            {
+                std::string str;
+                if (!text(info, arg, str))
+                {
+                    return false;
+                }
+                out = JSONObject{std::move(str)};
+                return true;
+            }
+            case major_array:
+                return list(info == indefinite, arg, out);
+            case major_map:
+                return dict(info == indefinite, arg, out);
+            case major_simple:
+                return simple(info, arg, out);
+            default:
+                // 字节串
+                return false;
+            }
+        }
+
+        bool simple(unsigned char info, uint64_t arg, JSONObject &out)
+        {
+            switch (info)
+            {
+            case 20:
+            case 21:
+                out = JSONObject{info == 21};
+                return true;
+            case 22:
+            case 23:
+                out = JSONObject{std::nullptr_t{}};
+                return true;
+            case 25:
+                out = JSONObject{half_to_double(uint16_t(arg))};
+                return true;
+            case 26:
+            {
+                uint32_t bits = uint32_t(arg);
+                float f;
+                std::memcpy(&f, &bits, 4);
+                out = JSONObject{double(f)};
+                return true;
+            }
+            case 27:
+            {
+                double d;
+                std::memcpy(&d, &arg, 8);
+                out = JSONObject{d};
+                return true;
+            }
+            default:
+                return false;
+            }
+        }
+
+        bool list(bool indef, uint64_t n, JSONObject &out)
+        {
+            if (++state.depth > opts.max_depth || (!indef && n > opts.max_elements))
+            {
+                return false;
+            }
+            JSONList res;
+            // 每个元素至少一个字节，长度字段不可信时不会多分配
+            res.reserve(indef ? 0 : size_t(std::min<uint64_t>(n, uint64_t(end - p))));
+            for (uint64_t i = 0; indef ? !is_break() : i < n; i++)
+            {
+                if (res.size() >= opts.max_elements)
+                {
+                    return false;
+                }
+                res.emplace_back();
+                if (!value(res.back()))
+                {
+                    return false;
+                }
+            }
+            state.depth--;
+            out = JSONObject{std::move(res)};
+            return true;
+        }
+
+        bool dict(bool indef, uint64_t n, JSONObject &out)
+        {
+            if (++state.depth > opts.max_depth || (!indef && n > opts.max_elements))
+            {
+                return false;
+            }
+            JSONDict res;
+            res.reserve(indef ? 0 : size_t(std::min<uint64_t>(n, uint64_t(end - p) / 2)));
+            std::string key;
+            for (uint64_t i = 0; indef ? !is_break() : i < n; i++)
+            {
+                unsigned char major, info;
+                uint64_t arg;
+                JSONObject val;
+                if (i >= opts.max_elements || !head(major, info, arg) || major != major_text || !text(info, arg, key) ||
+                    !value(val))
+                {
+                    return false;
+                }
+                res.try_emplace(std::move(key), std::move(val));
+            }
+            state.depth--;
+            out = JSONObject{std::move(res)};
+            return true;
+        }
+    };
+}
+
+// 把 obj 编码成 CBOR 追加到 out
+inline void cbor_encode(JSONObject const &obj, std::string &out)
+{
+    _cbor_details::encode(obj, out);
+}
+
+inline std::string cbor_encode(JSONObject const &obj)
+{
+    std::string out;
+    cbor_encode(obj, out);
+    return out;
+}
+
+// 解码 data 开头的一个 CBOR 数据项，返回值和吃掉的字节数，失败返回 0；opts 里的限制同样生效
+inline std::pair<JSONObject, size_t> cbor_decode(std::string_view data, ParseOptions const &opts = {})
+{
+    auto begin = reinterpret_cast<unsigned char const *>(data.data());
+    _cbor_details::_decoder dec{begin, begin + data.size(), opts, {}};
+    JSONObject res;
+    if (!dec.value(res))
+    {
+        return {JSONObject{std::nullptr_t{}}, 0};
+    }
+    return {std::move(res), size_t(dec.p - begin)};
+}
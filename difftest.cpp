@@ -0,0 +1,95 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "difftest.h"
+#include "schema_test.h"
+
+struct Batch
+{
+    std::string name;
+    std::vector<std::string> inputs;
+};
+
+// 对一批输入逐个比较所有引擎，并按引擎统计这一批的吞吐量
+static bool run_batch(std::vector<Engine> const &engines, Batch const &batch)
+{
+    size_t bytes = 0;
+    for (auto const &in : batch.inputs)
+    {
+        bytes += in.size();
+    }
+    auto timed = [&](auto &&run)
+    {
+        std::vector<ParseResult> results;
+        results.reserve(batch.inputs.size());
+        auto t0 = std::chrono::steady_clock::now();
+        for (auto const &in : batch.inputs)
+        {
+            results.push_back(run(in));
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double mbps = bytes / 1e6 / std::chrono::duration<double>(t1 - t0).count();
+        return std::pair{std::move(results), mbps};
+    };
+
+    auto [expect, ref_mbps] = timed([](std::string_view in)
+                                    { return try_parse(in); });
+    size_t accepted = 0;
+    for (auto const &r : expect)
+    {
+        accepted += r.ok();
+    }
+    print((batch.name + ":").c_str(), batch.inputs.size(), "inputs,", accepted, "accepted,", bytes, "bytes");
+    print("  try_parse:", ref_mbps, "MB/s");
+    bool ok = true;
+    for (auto const &engine : engines)
+    {
+        auto [got, mbps] = timed(engine.run);
+        print((std::string("  ") + engine.name + ":").c_str(), mbps, "MB/s");
+        for (size_t i = 0; i < got.size(); i++)
+        {
+            if (!same_result(expect[i], got[i]))
+            {
+                // 复现一次以打印详细信息
+                check_engines({engine}, batch.inputs[i]);
+                ok = false;
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
+// 用法: difftest [每类输入个数] [语料文件...]
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    std::vector<Engine> engines = make_engines();
+    JsonGenerator gen(20240611);
+    bool ok = true;
+    for (InputClass cls : {InputClass::Numbers, InputClass::Strings, InputClass::Nested, InputClass::Mixed, InputClass::Mutated})
+    {
+        Batch batch{input_class_name(cls), {}};
+        for (size_t i = 0; i < count; i++)
+        {
+            batch.inputs.push_back(gen.document(cls));
+        }
+        ok &= run_batch(engines, batch);
+    }
+    if (argc > 2)
+    {
+        Batch corpus{"corpus", {}};
+        for (int i = 2; i < argc; i++)
+        {
+            std::ifstream fin(argv[i], std::ios::binary);
+            std::stringstream ss;
+            ss << fin.rdbuf();
+            corpus.inputs.push_back(ss.str());
+        }
+        ok &= run_batch(engines, corpus);
+    }
+    ok &= check_schema(count);
+    print(ok ? "all engines agree" : "MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,454 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+#include "bson.h"
+#include "cbor.h"
+#include "intern.h"
+#include "json.h"
+#include "msgpack.h"
+#include "parser.h"
+#include "persistent.h"
+#include "shared.h"
+#include "snapshot.h"
+
+// 差分测试：每个引擎对同一输入的结果（错误码和位置，成功时还有吃掉的字节数和解析出的树）必须和参考实现 try_parse() 一致
+struct Engine
+{
+    char const *name;
+    std::function<ParseResult(std::string_view)> run;
+};
+
+// 把 basic_parser 的结果转成 JSONObject 和参考实现比较：int64_t 按 parse 的规则分成 int 和 double，重复的键取第一个
+template <class Policy>
+JSONObject to_object(basic_value<Policy> const &val)
+{
+    return std::visit(
+        overloaded{
+            [](int64_t num)
+            {
+                return INT32_MIN <= num && num <= INT32_MAX ? JSONObject{int(num)} : JSONObject{double(num)};
+            },
+            [](RawNumber num)
+            {
+                return parse(num.text).first;
+            },
+            [](std::string_view str)
+            {
+                return JSONObject{std::string(str)};
+            },
+            [](std::vector<basic_value<Policy>> const &list)
+            {
+                JSONList res;
+                for (auto const &v : list)
+                {
+                    res.push_back(to_object(v));
+                }
+                return JSONObject{std::move(res)};
+            },
+            [](typename basic_value<Policy>::dict_type const &dict)
+            {
+                JSONDict res;
+                for (auto const &[k, v] : dict)
+                {
+                    res.try_emplace(std::string(k), to_object(v));
+                }
+                return JSONObject{std::move(res)};
+            },
+            [](auto const &scalar)
+            {
+                return JSONObject{scalar};
+            },
+        },
+        val.inner);
+}
+
+// 和 parse 不同的一组策略
+struct FlatViewPolicy : DefaultParsePolicy
+{
+    using numbers = NumbersAsInt64OrDouble;
+    using strings = StringViews;
+    using dict = FlatDict;
+};
+
+// 新的解析路径在这里登记
+inline std::vector<Engine> make_engines()
+{
+    // 整个测试过程共用一个 Document，顺带检验节点回收
+    auto doc = std::make_shared<Document>();
+    return {
+        {"Document::parse", [doc](std::string_view json)
+         {
+             size_t eaten = doc->parse(json);
+             return ParseResult{doc->root, eaten, doc->error};
+         }},
+        {"try_parse(validate_utf8=false)", [](std::string_view json)
+         {
+             // 只对合法 UTF-8 的输入有可比性
+             if (!utf8_validate(json))
+             {
+                 return try_parse(json);
+             }
+             ParseOptions opts;
+             opts.validate_utf8 = false;
+             return try_parse(json, opts);
+         }},
+        {"basic_parser<DefaultParsePolicy>", [](std::string_view json)
+         {
+             basic_parser<> parser;
+             auto res = parser.parse(json);
+             return ParseResult{to_object(res.value), res.eaten, res.error};
+         }},
+        {"basic_parser<FlatViewPolicy>", [](std::string_view json)
+         {
+             basic_parser<FlatViewPolicy> parser;
+             auto res = parser.parse(json);
+             return ParseResult{to_object(res.value), res.eaten, res.error};
+         }},
+        {"try_parse(AllocatorNodes<pmr>)", [](std::string_view json)
+         {
+             std::pmr::monotonic_buffer_resource arena;
+             AllocatorNodes<std::pmr::polymorphic_allocator<char>> nodes{&arena};
+             auto res = try_parse(json, ParseOptions{}, nodes);
+             // 换回默认分配器再比较
+             return ParseResult{res.ok() ? try_parse(dump(res.value)).value : JSONObject{}, res.eaten, res.error};
+         }},
+        {"try_parse<RelaxedSyntax>", [](std::string_view json)
+         {
+             // 宽松模式接受的更多，只比较严格模式下合法的输入
+             ParseResult res = try_parse(json);
+             return res.ok() ? try_parse<RelaxedSyntax>(json) : res;
+         }},
+        {"try_parse(dump(try_parse))", [](std::string_view json)
+         {
+             ParseResult res = try_parse(json);
+             if (res.ok())
+             {
+                 res.value = try_parse(dump(res.value)).value;
+             }
+             return res;
+         }},
+        {"msgpack_decode(msgpack_encode(try_parse))", [](std::string_view json)
+         {
+             ParseResult res = try_parse(json);
+             if (res.ok())
+             {
+                 res.value = msgpack_decode(*msgpack_encode(res.value)).first;
+             }
+             return res;
+         }},
+        {"cbor_decode(cbor_encode(try_parse))", [](std::string_view json)
+         {
+             ParseResult res = try_parse(json);
+             if (res.ok())
+             {
+                 res.value = cbor_decode(cbor_encode(res.value)).first;
+             }
+             return res;
+         }},
+        {"bson_decode(bson_encode(try_parse))", [](std::string_view json)
+         {
+             // 只有顶层是字典、键里没有 '\0' 的文档能编码成 BSON
+             ParseResult res = try_parse(json);
+             std::string bson;
+             if (res.ok() && bson_encode(res.value, bson))
+             {
+                 res.value = bson_decode(bson).first;
+             }
+             return res;
+         }},
+        {"snapshot(try_parse).to_object()", [](std::string_view json)
+         {
+             ParseResult res = try_parse(json);
+             if (res.ok())
+             {
+                 auto snap = Snapshot::from_bytes(snapshot_write(res.value));
+                 res.value = snap != nullptr && snap->check() ? snap->root().to_object() : JSONObject{std::nullptr_t{}};
+             }
+             return res;
+         }},
+        {"PersistentJSON(try_parse) rebuilt with set/push_back", [](std::string_view json)
+         {
+             ParseResult res = try_parse(json);
+             if (res.ok())
+             {
+                 // 逐项加回去，每一步都产生新版本，最后应该和整棵转过来的相等
+                 PersistentJSON whole(res.value);
+                 PersistentJSON rebuilt = whole;
+                 if (whole.is<JSONDict>())
+                 {
+                     rebuilt = PersistentJSON(PersistentJSON::Dict{});
+                     for (auto const &[k, v] : whole.as_dict())
+                     {
+                         rebuilt = rebuilt.set(k, v);
+                     }
+                 }
+                 else if (whole.is<JSONList>())
+                 {
+                     rebuilt = PersistentJSON(PersistentJSON::List{});
+                     for (auto const &v : whole.as_list())
+                     {
+                         rebuilt = rebuilt.push_back(v);
+                     }
+                 }
+                 res.value = rebuilt == whole ? rebuilt.to_object() : JSONObject{std::nullptr_t{}};
+             }
+             return res;
+         }},
+        {"JSONInterner.intern(try_parse)", [](std::string_view json)
+         {
+             ParseResult res = try_parse(json);
+             if (res.ok())
+             {
+                 // 重新解析 dump 的结果，字典的遍历顺序可能不同，合并后仍应是同一个节点
+                 JSONInterner interner;
+                 PersistentJSON first = interner.intern(res.value);
+                 PersistentJSON again = interner.intern(try_parse(dump(res.value)).value);
+                 res.value = first.same_node(again) ? again.to_object() : JSONObject{std::nullptr_t{}};
+             }
+             return res;
+         }},
+#if defined(__unix__) || defined(__APPLE__)
+        {"SharedDocument(shared_publish(try_parse))", [](std::string_view json)
+         {
+             ParseResult res = try_parse(json);
+             if (res.ok())
+             {
+                 std::string name = "/babyjson-difftest-" + std::to_string(getpid());
+                 shared_publish(name, res.value);
+                 auto doc = SharedDocument::open(name);
+                 auto snap = doc != nullptr ? doc->current() : nullptr;
+                 res.value = snap != nullptr ? snap->root().to_object() : JSONObject{std::nullptr_t{}};
+                 shared_remove(name);
+             }
+             return res;
+         }},
+#endif
+        {"validate", [](std::string_view json)
+         {
+             // validate 不建树，成功时借前缀 parse 补上值，和参考实现比的主要是错误码和位置
+             ParseError err = validate(json);
+             if (err.code != ParseErrc::Ok)
+             {
+                 return ParseResult{JSONObject{std::nullptr_t{}}, 0, err};
+             }
+             auto [obj, eaten] = parse(json);
+             return ParseResult{std::move(obj), eaten, err};
+         }},
+        {"try_parse(minify)", [](std::string_view json)
+         {
+             std::string out;
+             ParseError err = minify(json, out);
+             if (err.code != ParseErrc::Ok)
+             {
+                 return ParseResult{JSONObject{std::nullptr_t{}}, 0, err};
+             }
+             return ParseResult{try_parse(out).value, parse(json).second, err};
+         }},
+        {"try_parse(prettify)", [](std::string_view json)
+         {
+             std::string out;
+             ParseError err = prettify(json, out, 2);
+             if (err.code != ParseErrc::Ok)
+             {
+                 return ParseResult{JSONObject{std::nullptr_t{}}, 0, err};
+             }
+             return ParseResult{try_parse(out).value, parse(json).second, err};
+         }},
+    };
+}
+
+inline bool same_result(ParseResult const &expect, ParseResult const &got)
+{
+    return expect.error.code == got.error.code && expect.error.offset == got.error.offset &&
+           expect.error.line == got.error.line && expect.error.column == got.error.column &&
+           expect.eaten == got.eaten && (!expect.ok() || expect.value == got.value);
+}
+
+// 逐个引擎与参考实现比较，出现分歧时打印引擎名和输入并返回 false
+inline bool check_engines(std::vector<Engine> const &engines, std::string_view json)
+{
+    ParseResult expect = try_parse(json);
+    for (auto const &engine : engines)
+    {
+        ParseResult got = engine.run(json);
+        if (!same_result(expect, got))
+        {
+            std::string quoted;
+            escape_string(json, quoted);
+            print("mismatch in", engine.name, "on input", quoted.c_str());
+            print("  expect:", expect.eaten, expect.error, expect.value);
+            print("  got:   ", got.eaten, got.error, got.value);
+            return false;
+        }
+    }
+    return true;
+}
+
+enum class InputClass
+{
+    Numbers,
+    Strings,
+    Nested,
+    Mixed,
+    Mutated,
+};
+
+inline char const *input_class_name(InputClass cls)
+{
+    switch (cls)
+    {
+    case InputClass::Numbers:
+        return "numbers";
+    case InputClass::Strings:
+        return "strings";
+    case InputClass::Nested:
+        return "nested";
+    case InputClass::Mixed:
+        return "mixed";
+    default:
+        return "mutated";
+    }
+}
+
+// 按输入类别生成随机 JSON 文本，Mutated 在 Mixed 的基础上随机改坏字节或截断
+struct JsonGenerator
+{
+    std::mt19937_64 rng;
+
+    explicit JsonGenerator(uint64_t seed) : rng(seed)
+    {
+    }
+
+    size_t pick(size_t n)
+    {
+        return rng() % n;
+    }
+
+    void whitespace(std::string &out)
+    {
+        static char const ws[] = " \n\t\r";
+        while (pick(4) == 0)
+        {
+            out += ws[pick(4)];
+        }
+    }
+
+    void number(std::string &out)
+    {
+        char buf[32];
+        switch (pick(4))
+        {
+        case 0:
+            out += std::to_string(int64_t(rng()) >> pick(64));
+            break;
+        case 1:
+            out.append(buf, double_to_chars(std::ldexp(double(int64_t(rng()) >> 11), int(pick(200)) - 100), buf));
+            break;
+        case 2:
+            std::snprintf(buf, sizeof(buf), "%.*e", int(pick(17)), double(rng() % 1000000) / 997.0);
+            out += buf;
+            break;
+        default:
+            std::snprintf(buf, sizeof(buf), "%.*f", int(pick(8)), double(int64_t(rng() % 2000000) - 1000000) / 1000.0);
+            out += buf;
+        }
+    }
+
+    void string(std::string &out)
+    {
+        static char const *const pieces[] = {"a", "hello", " ", "\\n", "\\\"", "\\\\", "\\/", "\\t", "\\u00e9", "\\u4e2d",
+                                             "\\ud83d\\ude00", "\xc3\xa9", "\xe4\xb8\xad", "\xf0\x9f\x98\x80", "0123456789abcdef"};
+        out += '"';
+        size_t n = pick(4) == 0 ? pick(200) : pick(12);
+        for (size_t i = 0; i < n; i++)
+        {
+            out += pieces[pick(std::size(pieces))];
+        }
+        out += '"';
+    }
+
+    void value(std::string &out, InputClass cls, int depth)
+    {
+        size_t kind = pick(8);
+        if (depth > 0 && (cls == InputClass::Nested ? kind < 5 : kind < 2))
+        {
+            bool is_list = pick(2) == 0;
+            out += is_list ? '[' : '{';
+            size_t n = cls == InputClass::Nested ? pick(4) : pick(12);
+            for (size_t i = 0; i < n; i++)
+            {
+                if (i != 0)
+                {
+                    out += ',';
+                }
+                whitespace(out);
+                if (!is_list)
+                {
+                    string(out);
+                    out += ':';
+                    whitespace(out);
+                }
+                value(out, cls, depth - 1);
+            }
+            out += is_list ? ']' : '}';
+            return;
+        }
+        if (cls == InputClass::Numbers || (cls != InputClass::Strings && kind < 5))
+        {
+            number(out);
+        }
+        else if (cls == InputClass::Strings || kind < 7)
+        {
+            string(out);
+        }
+        else
+        {
+            out += pick(2) ? "true" : "false";
+        }
+    }
+
+    std::string document(InputClass cls)
+    {
+        std::string out;
+        whitespace(out);
+        if (cls == InputClass::Numbers || cls == InputClass::Strings)
+        {
+            // 扁平的大数组，集中测单一类型的转换
+            out += '[';
+            size_t n = 1 + pick(64);
+            for (size_t i = 0; i < n; i++)
+            {
+                if (i != 0)
+                {
+                    out += ',';
+                }
+                value(out, cls, 0);
+            }
+            out += ']';
+        }
+        else
+        {
+            value(out, cls == InputClass::Mutated ? InputClass::Mixed : cls, cls == InputClass::Nested ? 12 : 4);
+        }
+        if (cls == InputClass::Mutated && !out.empty())
+        {
+            for (size_t n = 1 + pick(3); n > 0; n--)
+            {
+                out[pick(out.size())] = char(rng());
+            }
+            if (pick(4) == 0)
+            {
+                out.resize(pick(out.size()));
+            }
+        }
+        return out;
+    }
+};
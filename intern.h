@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "json.h"
+#include "persistent.h"
+
+// 哈希合并（hash-consing）：内容相同的字符串、列表、字典只存一份，重复的子树共用 PersistentJSON 的不可变节点
+// 自底向上进行，子节点已经合并过，内容相同的子树必然是同一个节点；
+// 所以一个节点的哈希只用子节点的地址算，比较也只看子节点是不是同一个，都和节点的直接子节点数成正比，不会深入整棵子树
+// 合并表持有所有见过的节点，同一个 JSONInterner 处理的多个文档之间也会共享；导入结束后销毁它，不再用到的节点才会释放
+//
+//     JSONInterner interner;
+//     for (auto &doc : catalogue)
+//     {
+//         shared.push_back(interner.intern(std::move(doc)));
+//     }
+
+class JSONInterner
+{
+public:
+    // 把 obj 转成 PersistentJSON，内容相同的部分和之前合并过的共用节点
+    PersistentJSON intern(JSONObject obj)
+    {
+        return std::visit(
+            overloaded{
+                [&](std::string &val)
+                {
+                    size_t h = mix(json_index<std::string>, std::hash<std::string>{}(val));
+                    auto hit = lookup(h, json_index<std::string>, [&](PersistentJSON const &cand)
+                                      { return cand.as_string() == val; });
+                    return hit != nullptr ? *hit : add(h, PersistentJSON(JSONObject{std::move(val)}));
+                },
+                [&](JSONList &val)
+                {
+                    PersistentJSON::List list;
+                    list.reserve(val.size());
+                    size_t h = json_index<JSONList>;
+                    for (auto &v : val)
+                    {
+                        list.push_back(intern(std::move(v)));
+                        h = mix(h, node_hash(list.back()));
+                    }
+                    auto equal = [&](PersistentJSON const &cand)
+                    {
+                        auto const &other = cand.as_list();
+                        if (other.size() != list.size())
+                        {
+                            return false;
+                        }
+                        for (size_t i = 0; i < list.size(); i++)
+                        {
+                            if (!same(other[i], list[i]))
+                            {
+                                return false;
+                            }
+                        }
+                        return true;
+                    };
+                    auto hit = lookup(h, json_index<JSONList>, equal);
+                    return hit != nullptr ? *hit : add(h, PersistentJSON(std::move(list)));
+                },
+                [&](JSONDict &val)
+                {
+                    PersistentJSON::Dict dict;
+                    dict.reserve(val.size());
+                    // 同样内容的字典遍历顺序可能不同，各项的哈希用加法合并
+                    size_t sum = 0;
+                    while (!val.empty())
+                    {
+                        auto node = val.extract(val.begin());
+                        auto [it, _] = dict.try_emplace(std::move(node.key()), intern(std::move(node.mapped())));
+                        sum += mix(std::hash<std::string>{}(it->first), node_hash(it->second));
+                    }
+                    auto equal = [&](PersistentJSON const &cand)
+                    {
+                        auto const &other = cand.as_dict();
+                        if (other.size() != dict.size())
+                        {
+                            return false;
+                        }
+                        for (auto const &[k, v] : dict)
+                        {
+                            auto it = other.find(k);
+                            if (it == other.end() || !same(it->second, v))
+                            {
+                                return false;
+                            }
+                        }
+                        return true;
+                    };
+                    size_t h = mix(json_index<JSONDict>, sum);
+                    auto hit = lookup(h, json_index<JSONDict>, equal);
+                    return hit != nullptr ? *hit : add(h, PersistentJSON(std::move(dict)));
+                },
+                [&](auto scalar)
+                {
+                    return PersistentJSON(JSONObject{scalar});
+                },
+            },
+            obj.inner);
+    }
+
+    // 合并表里不同的字符串、列表、字典节点数
+    size_t size() const
+    {
+        return table.size();
+    }
+
+    // 合并时找到现成节点的次数
+    size_t hits() const
+    {
+        return reused;
+    }
+
+private:
+    static size_t mix(size_t h, size_t v)
+    {
+        // 64 位的 boost::hash_combine
+        return h ^ (v + 0x9e3779b97f4a7c15ull + (h << 12) + (h >> 4));
+    }
+
+    // double 按位比较和哈希：0.0 和 -0.0、不同的 NaN 都要分开，合并不能改变数据
+    static uint64_t double_bits(double val)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &val, sizeof(bits));
+        return bits;
+    }
+
+    // 两个已合并的子节点是否完全相同：double 按位，其余同 same_node
+    static bool same(PersistentJSON const &a, PersistentJSON const &b)
+    {
+        if (a.is<double>() && b.is<double>())
+        {
+            return double_bits(a.as_double()) == double_bits(b.as_double());
+        }
+        return a.same_node(b);
+    }
+
+    // 子节点已经合并过，字符串、列表、字典按节点地址哈希，标量按值
+    static size_t node_hash(PersistentJSON const &val)
+    {
+        switch (val.index())
+        {
+        case json_index<bool>:
+            return mix(json_index<bool>, val.as_bool());
+        case json_index<int>:
+            return mix(json_index<int>, std::hash<int>{}(val.as_int()));
+        case json_index<double>:
+            return mix(json_index<double>, std::hash<uint64_t>{}(double_bits(val.as_double())));
+        case json_index<std::string>:
+            return std::hash<void const *>{}(&val.as_string());
+        case json_index<JSONList>:
+            return std::hash<void const *>{}(&val.as_list());
+        case json_index<JSONDict>:
+            return std::hash<void const *>{}(&val.as_dict());
+        default:
+            return 0;
+        }
+    }
+
+    // 在哈希为 h、类型为 index 的节点里找 equal 的，没有返回 nullptr
+    template <class Equal>
+    PersistentJSON const *lookup(size_t h, size_t index, Equal const &equal)
+    {
+        auto range = table.equal_range(h);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second.index() == index && equal(it->second))
+            {
+                reused++;
+                return &it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    PersistentJSON add(size_t h, PersistentJSON fresh)
+    {
+        table.emplace(h, fresh);
+        return fresh;
+    }
+
+    std::unordered_multimap<size_t, PersistentJSON> table;
+    size_t reused = 0;
+};
@@ -0,0 +1,1701 @@
+#pragma once
+
+#include <variant>
+#include <memory>
+#include <functional>
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <charconv>
+#include <cstdint>
+#include <cmath>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "print.h"
+#include "utf8.h"
+#include "float_parse.h"
+#include "ryu.h"
+#include "trace.h"
+
+template <class Allocator = std::allocator<char>>
+struct basic_json;
+
+template <class Allocator>
+void dump(basic_json<Allocator> const &obj, std::string &out);
+
+// 用标准库默认分配器的 JSON 值，各处默认都用它
+using JSONObject = basic_json<>;
+
+// 自定义分配器的字符串没有 std::hash 特化，按内容哈希
+struct JSONStringHash
+{
+    template <class Str>
+    size_t operator()(Str const &str) const
+    {
+        return std::hash<std::string_view>{}(std::string_view(str.data(), str.size()));
+    }
+};
+
+// 字符串、列表、字典的存储都从 Allocator 重新绑定得到，可以换成共享内存、线程私有或大页的分配器
+// 有状态的分配器要在构造容器时传入，解析时见 AllocatorNodes
+template <class Allocator>
+struct basic_json
+{
+    // 没有 allocator_type 成员，否则 pmr 容器会试图带着分配器构造 basic_json
+    template <class T>
+    using allocator_for = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+    using string_type = std::basic_string<char, std::char_traits<char>, allocator_for<char>>;
+    using list_type = std::vector<basic_json, allocator_for<basic_json>>;
+    using dict_type = std::unordered_map<string_type, basic_json,
+                                         std::conditional_t<std::is_same_v<string_type, std::string>, std::hash<std::string>, JSONStringHash>,
+                                         std::equal_to<string_type>, allocator_for<std::pair<string_type const, basic_json>>>;
+
+    std::variant<std::nullptr_t // null
+                 ,
+                 bool // true
+                 ,
+                 int // 42
+                 ,
+                 double // 3.14
+                 ,
+                 string_type // "hello"
+                 ,
+                 list_type // [42, "hello"]
+                 ,
+                 dict_type // {"hello": 985, "world": 211}
+                 >
+        inner;
+
+    void do_print() const
+    {
+        std::string out;
+        dump(*this, out);
+        std::cout << out;
+    }
+
+    template <class T>
+    bool is() const
+    {
+        return std::holds_alternative<T>(inner);
+    }
+
+    template <class T>
+    T const &get() const
+    {
+        return std::get<T>(inner);
+    }
+
+    template <class T>
+    T &get()
+    {
+        return std::get<T>(inner);
+    }
+
+    bool operator==(basic_json const &other) const
+    {
+        return inner == other.inner;
+    }
+
+    bool operator!=(basic_json const &other) const
+    {
+        return inner != other.inner;
+    }
+};
+
+using JSONDict = JSONObject::dict_type;
+using JSONList = JSONObject::list_type;
+
+// 类型 T 在 JSONObject::inner 里的下标，用来和 inner.index() 比较
+template <class T, class... Ts>
+constexpr size_t variant_index(std::variant<Ts...> const *)
+{
+    constexpr bool same[] = {std::is_same_v<T, Ts>...};
+    for (size_t i = 0; i < sizeof...(Ts); i++)
+    {
+        if (same[i])
+        {
+            return i;
+        }
+    }
+    return std::variant_npos;
+}
+
+template <class T>
+constexpr size_t json_index = variant_index<T>(static_cast<decltype(JSONObject::inner) const *>(nullptr));
+
+template <class T>
+inline std::optional<T> try_parse_num(std::string_view str)
+{
+    T value;
+    auto res = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (res.ec == std::errc() && res.ptr == str.data() + str.size())
+    {
+        return value;
+    }
+    return std::nullopt;
+}
+
+// RFC 8259 只允许这几个单字符转义
+inline std::optional<char> unescaped_char(char c)
+{
+    switch (c)
+    {
+    case '"':
+        return '"';
+    case '\\':
+        return '\\';
+    case '/':
+        return '/';
+    case 'n':
+        return '\n';
+    case 'r':
+        return '\r';
+    case 't':
+        return '\t';
+    case 'f':
+        return '\f';
+    case 'b':
+        return '\b';
+    default:
+        return std::nullopt;
+    }
+}
+
+template <class Str>
+void append_utf8(Str &str, uint32_t cp)
+{
+    if (cp < 0x80)
+    {
+        str += char(cp);
+    }
+    else if (cp < 0x800)
+    {
+        char buf[2] = {char(0xC0 | (cp >> 6)), char(0x80 | (cp & 0x3F))};
+        str.append(buf, 2);
+    }
+    else if (cp < 0x10000)
+    {
+        char buf[3] = {char(0xE0 | (cp >> 12)), char(0x80 | ((cp >> 6) & 0x3F)), char(0x80 | (cp & 0x3F))};
+        str.append(buf, 3);
+    }
+    else
+    {
+        char buf[4] = {char(0xF0 | (cp >> 18)), char(0x80 | ((cp >> 12) & 0x3F)), char(0x80 | ((cp >> 6) & 0x3F)), char(0x80 | (cp & 0x3F))};
+        str.append(buf, 4);
+    }
+}
+
+// json 以 "\u" 开头，解码 \uXXXX（高代理项连同后面的 \uXXXX 低代理项一起）为 UTF-8 追加到 str
+// 返回吃掉的字节数，格式错误或孤立的代理项返回 0
+template <class Str>
+size_t unescaped_unicode(std::string_view json, Str &str)
+{
+    auto hex4 = [&](size_t pos) -> int32_t
+    {
+        if (pos + 4 > json.size())
+        {
+            return -1;
+        }
+        int32_t val = 0;
+        for (size_t k = pos; k < pos + 4; k++)
+        {
+            char ch = json[k];
+            val <<= 4;
+            if ('0' <= ch && ch <= '9')
+                val |= ch - '0';
+            else if ('a' <= ch && ch <= 'f')
+                val |= ch - 'a' + 10;
+            else if ('A' <= ch && ch <= 'F')
+                val |= ch - 'A' + 10;
+            else
+                return -1;
+        }
+        return val;
+    };
+    int32_t cp = hex4(2);
+    if (cp < 0 || (0xDC00 <= cp && cp <= 0xDFFF))
+    {
+        return 0;
+    }
+    size_t eaten = 6;
+    if (0xD800 <= cp && cp <= 0xDBFF)
+    {
+        if (json.size() < 12 || json[6] != '\\' || json[7] != 'u')
+        {
+            return 0;
+        }
+        int32_t lo = hex4(8);
+        if (lo < 0xDC00 || lo > 0xDFFF)
+        {
+            return 0;
+        }
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+        eaten = 12;
+    }
+    append_utf8(str, uint32_t(cp));
+    return eaten;
+}
+
+// 返回 [p, p + n) 中第一个需要转义的字节（'"'、'\\' 或 0x00-0x1F）的下标，没有则返回 n
+inline size_t find_escape_needed(char const *p, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i const quote32 = _mm256_set1_epi8('"');
+    __m256i const slash32 = _mm256_set1_epi8('\\');
+    __m256i const ctrl32 = _mm256_set1_epi8(0x1F);
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + i));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, slash32)),
+                                      _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl32), v));
+        uint32_t mask = uint32_t(_mm256_movemask_epi8(hit));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i const quote16 = _mm_set1_epi8('"');
+    __m128i const slash16 = _mm_set1_epi8('\\');
+    __m128i const ctrl16 = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote16), _mm_cmpeq_epi8(v, slash16)),
+                                   _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl16), v));
+        uint32_t mask = uint32_t(_mm_movemask_epi8(hit));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < n; i++)
+    {
+        unsigned char ch = static_cast<unsigned char>(p[i]);
+        if (ch == '"' || ch == '\\' || ch < 0x20)
+        {
+            return i;
+        }
+    }
+    return n;
+}
+
+// 解析失败的原因
+enum class ParseErrc
+{
+    Ok,
+    UnexpectedEnd,          // 输入提前结束
+    UnexpectedChar,         // 不能作为值开头的字符
+    InvalidLiteral,         // true、false、null 拼写错误
+    InvalidNumber,
+    NumberOutOfRange,       // 超出 double 的范围
+    InvalidEscape,
+    InvalidUnicodeEscape,   // \uXXXX 格式错误或孤立的代理项
+    InvalidUtf8,
+    ControlCharacter,       // 字符串里未转义的 0x00-0x1F
+    ExpectedKey,
+    ExpectedColon,
+    ExpectedCommaOrBracket,
+    ExpectedCommaOrBrace,
+    TrailingCharacters,     // 完整的值后面还有非空白字符
+    DepthLimit,
+    StringLimit,
+    ElementLimit,
+    NodeLimit,
+};
+
+inline char const *parse_error_message(ParseErrc code)
+{
+    switch (code)
+    {
+    case ParseErrc::Ok:
+        return "ok";
+    case ParseErrc::UnexpectedEnd:
+        return "unexpected end of input";
+    case ParseErrc::UnexpectedChar:
+        return "unexpected character";
+    case ParseErrc::InvalidLiteral:
+        return "invalid literal";
+    case ParseErrc::InvalidNumber:
+        return "invalid number";
+    case ParseErrc::NumberOutOfRange:
+        return "number out of range";
+    case ParseErrc::InvalidEscape:
+        return "invalid escape";
+    case ParseErrc::InvalidUnicodeEscape:
+        return "invalid unicode escape";
+    case ParseErrc::InvalidUtf8:
+        return "invalid UTF-8";
+    case ParseErrc::ControlCharacter:
+        return "unescaped control character in string";
+    case ParseErrc::ExpectedKey:
+        return "expected string key";
+    case ParseErrc::ExpectedColon:
+        return "expected ':'";
+    case ParseErrc::ExpectedCommaOrBracket:
+        return "expected ',' or ']'";
+    case ParseErrc::ExpectedCommaOrBrace:
+        return "expected ',' or '}'";
+    case ParseErrc::TrailingCharacters:
+        return "trailing characters";
+    case ParseErrc::DepthLimit:
+        return "nesting too deep";
+    case ParseErrc::StringLimit:
+        return "string too long";
+    case ParseErrc::ElementLimit:
+        return "too many elements";
+    case ParseErrc::NodeLimit:
+        return "too many values";
+    }
+    return "unknown error";
+}
+
+// 错误码和出错位置：offset 从 0 开始按字节计，line 和 column 从 1 开始，column 也按字节计
+struct ParseError
+{
+    ParseErrc code = ParseErrc::Ok;
+    size_t offset = 0;
+    size_t line = 0;
+    size_t column = 0;
+
+    void do_print() const
+    {
+        std::cout << parse_error_message(code);
+        if (code != ParseErrc::Ok)
+        {
+            std::cout << " at line " << line << ", column " << column << " (offset " << offset << ")";
+        }
+    }
+};
+
+// 行号和列号只在失败时数换行符得到，成功路径上没有额外开销
+inline ParseError make_parse_error(std::string_view json, ParseErrc code, size_t offset)
+{
+    size_t line = 1;
+    size_t line_begin = 0;
+    for (size_t i = json.find('\n'); i < offset; i = json.find('\n', i + 1))
+    {
+        line++;
+        line_begin = i + 1;
+    }
+    return {code, offset, line, offset - line_begin + 1};
+}
+
+// 失败时 value 为 null、eaten 为 0，原因见 error
+template <class Json>
+struct basic_parse_result
+{
+    Json value;
+    size_t eaten = 0;
+    ParseError error;
+
+    bool ok() const
+    {
+        return error.code == ParseErrc::Ok;
+    }
+};
+
+using ParseResult = basic_parse_result<JSONObject>;
+
+struct ParseOptions
+{
+    // 输入可信时可关闭字符串的 UTF-8 校验
+    bool validate_utf8 = true;
+    // 以下限制用于解析不可信的输入，超出即解析失败
+    size_t max_depth = 1024;                 // 列表、字典的嵌套层数，同时限制了递归深度
+    size_t max_string_length = SIZE_MAX;     // 解码后单个字符串（含键）的字节数
+    size_t max_elements = SIZE_MAX;          // 单个列表、字典的元素个数，重复的键也计数
+    size_t max_nodes = SIZE_MAX;             // 整个文档的值的总数
+};
+
+// 一次解析过程中的计数，用来执行 ParseOptions 里的限制，并记下出错的位置
+struct ParseState
+{
+    size_t depth = 0;
+    size_t nodes = 0;
+    ParseErrc error = ParseErrc::Ok;
+    char const *error_at = nullptr; // 指向输入缓冲区内
+
+    // 出错后各层只是沿返回值 0 逐层退出，最内层记下的就是第一个错误
+    void fail(ParseErrc code, char const *where)
+    {
+        error = code;
+        error_at = where;
+    }
+};
+
+// 返回 pos 起第一个非空白字符（空白指 ' ' 和 '\t' '\n' '\v' '\f' '\r'）的下标，没有则返回 npos
+// 大多数空白只有一两个字节，先单独看第一个字节，长的缩进再整块比较
+inline size_t skip_whitespace(std::string_view json, size_t pos = 0)
+{
+    BABYJSON_TRACE_SCOPE(Whitespace);
+    auto is_space = [](char ch)
+    {
+        return ch == ' ' || unsigned(static_cast<unsigned char>(ch) - '\t') <= unsigned('\r' - '\t');
+    };
+    char const *p = json.data();
+    size_t n = json.size();
+    size_t i = pos;
+    if (i < n && !is_space(p[i]))
+    {
+        return i;
+    }
+#if defined(__AVX2__)
+    __m256i const space32 = _mm256_set1_epi8(' ');
+    __m256i const tab32 = _mm256_set1_epi8('\t');
+    __m256i const range32 = _mm256_set1_epi8('\r' - '\t');
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + i));
+        __m256i off = _mm256_sub_epi8(v, tab32);
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, space32), _mm256_cmpeq_epi8(_mm256_min_epu8(off, range32), off));
+        uint32_t mask = ~uint32_t(_mm256_movemask_epi8(hit));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i const space16 = _mm_set1_epi8(' ');
+    __m128i const tab16 = _mm_set1_epi8('\t');
+    __m128i const range16 = _mm_set1_epi8('\r' - '\t');
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + i));
+        __m128i off = _mm_sub_epi8(v, tab16);
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, space16), _mm_cmpeq_epi8(_mm_min_epu8(off, range16), off));
+        uint32_t mask = ~uint32_t(_mm_movemask_epi8(hit)) & 0xFFFF;
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < n; i++)
+    {
+        if (!is_space(p[i]))
+        {
+            return i;
+        }
+    }
+    return json.npos;
+}
+
+// 语法策略，作为模板参数传给 parse、try_parse、scan 等，编译期决定，严格模式不多一个分支
+// 默认严格按 RFC 8259
+struct StrictSyntax
+{
+    static constexpr bool comments = false;        // 把 // 到行尾和 /* */ 注释当作空白
+    static constexpr bool trailing_commas = false; // 列表、字典的最后一个元素后面可以多一个逗号
+};
+
+// JSON5 的一小部分，用于手写的配置文件
+struct RelaxedSyntax
+{
+    static constexpr bool comments = true;
+    static constexpr bool trailing_commas = true;
+};
+
+// 同 skip_whitespace，Syntax 允许注释时连注释一起跳过；没有结束的块注释不算空白，由调用方在它的位置报错
+template <class Syntax>
+inline size_t skip_space(std::string_view json, size_t pos = 0)
+{
+    size_t i = skip_whitespace(json, pos);
+    if constexpr (Syntax::comments)
+    {
+        while (i != json.npos && json[i] == '/' && i + 1 < json.size())
+        {
+            size_t end;
+            if (json[i + 1] == '/')
+            {
+                end = json.find('\n', i + 2);
+                end = end == json.npos ? json.size() : end + 1;
+            }
+            else if (json[i + 1] == '*' && (end = json.find("*/", i + 2)) != json.npos)
+            {
+                end += 2;
+            }
+            else
+            {
+                break;
+            }
+            i = skip_whitespace(json, end);
+        }
+    }
+    return i;
+}
+
+// 只记录解码后长度的字符串替身，只做校验时代替 std::string 传给 parse_string
+struct StringLength
+{
+    size_t n = 0;
+
+    void append(char const *, size_t count)
+    {
+        n += count;
+    }
+
+    StringLength &operator+=(char)
+    {
+        n++;
+        return *this;
+    }
+
+    size_t size() const
+    {
+        return n;
+    }
+};
+
+// json 以 '"' 开头，把解码后的内容追加到 str，返回吃掉的字节数（含两端引号），失败返回 0
+template <class Str>
+size_t parse_string(std::string_view json, Str &str, ParseOptions const &opts, ParseState &state)
+{
+    BABYJSON_TRACE_SCOPE(String);
+    size_t i = 1;
+    for (;;)
+    {
+        // 整块拷贝不含转义的片段，只在反斜杠、引号和控制字符处走标量路径
+        size_t run = find_escape_needed(json.data() + i, json.size() - i);
+        if (str.size() + run > opts.max_string_length)
+        {
+            state.fail(ParseErrc::StringLimit, json.data());
+            return 0;
+        }
+        str.append(json.data() + i, run);
+        i += run;
+        if (i >= json.size())
+        {
+            state.fail(ParseErrc::UnexpectedEnd, json.data() + json.size());
+            return 0;
+        }
+        if (json[i] == '"')
+        {
+            break;
+        }
+        if (json[i] != '\\')
+        {
+            state.fail(ParseErrc::ControlCharacter, json.data() + i);
+            return 0;
+        }
+        if (i + 1 >= json.size())
+        {
+            state.fail(ParseErrc::UnexpectedEnd, json.data() + json.size());
+            return 0;
+        }
+        if (json[i + 1] == 'u')
+        {
+            size_t eaten = unescaped_unicode(json.substr(i), str);
+            if (eaten == 0)
+            {
+                state.fail(ParseErrc::InvalidUnicodeEscape, json.data() + i);
+                return 0;
+            }
+            i += eaten;
+        }
+        else if (auto ch = unescaped_char(json[i + 1]))
+        {
+            str += *ch;
+            i += 2;
+        }
+        else
+        {
+            state.fail(ParseErrc::InvalidEscape, json.data() + i);
+            return 0;
+        }
+    }
+    if (str.size() > opts.max_string_length)
+    {
+        state.fail(ParseErrc::StringLimit, json.data());
+        return 0;
+    }
+    // 转义序列都是 ASCII，直接校验原始字节即可；出错后再用标量版本定位
+    if (opts.validate_utf8 && !utf8_validate(json.substr(1, i - 1)))
+    {
+        state.fail(ParseErrc::InvalidUtf8, json.data() + 1 + utf8_first_invalid(json.substr(1, i - 1)));
+        return 0;
+    }
+    return i + 1;
+}
+
+// scan_number 的结果：尾数 w 和十进制指数 exp10，有效数字不超过 19 位时 w 是准确的
+struct NumberToken
+{
+    size_t length = 0; // 数的原文长度
+    bool negative = false;
+    bool is_float = false; // 带小数点或指数
+    uint64_t w = 0;
+    int64_t exp10 = 0;
+    size_t digits = 0; // 有效数字位数，不计前导零
+};
+
+// json 以 '-' 或数字开头，检查语法并累积尾数，不做转换；失败返回 false，原因和位置记在 state 里
+inline bool scan_number(std::string_view json, ParseState &state, NumberToken &tok)
+{
+    auto fail = [&](ParseErrc code, char const *where)
+    {
+        state.fail(code, where);
+        return false;
+    };
+    // 一遍扫描同时累积尾数和十进制指数，语法同 -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    auto is_digit = [](char ch)
+    {
+        return '0' <= ch && ch <= '9';
+    };
+    tok.negative = json[0] == '-';
+    size_t i = tok.negative ? 1 : 0;
+    auto accumulate = [&](char ch)
+    {
+        unsigned d = unsigned(ch - '0');
+        if (tok.w != 0 || d != 0)
+        {
+            tok.digits++;
+        }
+        tok.w = tok.w * 10 + d;
+    };
+    size_t int_begin = i;
+    for (; i < json.size() && is_digit(json[i]); i++)
+    {
+        accumulate(json[i]);
+    }
+    if (i == int_begin)
+    {
+        return fail(i < json.size() ? ParseErrc::InvalidNumber : ParseErrc::UnexpectedEnd, json.data() + i);
+    }
+    // 不允许多余的前导零
+    if (json[int_begin] == '0' && i - int_begin > 1)
+    {
+        return fail(ParseErrc::InvalidNumber, json.data() + int_begin);
+    }
+    if (i < json.size() && json[i] == '.')
+    {
+        tok.is_float = true;
+        size_t frac_begin = ++i;
+        for (; i < json.size() && is_digit(json[i]); i++)
+        {
+            accumulate(json[i]);
+            tok.exp10--;
+        }
+        if (i == frac_begin)
+        {
+            return fail(i < json.size() ? ParseErrc::InvalidNumber : ParseErrc::UnexpectedEnd, json.data() + i);
+        }
+    }
+    if (i < json.size() && (json[i] == 'e' || json[i] == 'E'))
+    {
+        i++;
+        bool exp_negative = false;
+        if (i < json.size() && (json[i] == '+' || json[i] == '-'))
+        {
+            exp_negative = json[i] == '-';
+            i++;
+        }
+        if (i == json.size() || !is_digit(json[i]))
+        {
+            return fail(i < json.size() ? ParseErrc::InvalidNumber : ParseErrc::UnexpectedEnd, json.data() + i);
+        }
+        int64_t e = 0;
+        for (; i < json.size() && is_digit(json[i]); i++)
+        {
+            if (e < 100000)
+            {
+                e = e * 10 + (json[i] - '0');
+            }
+        }
+        tok.exp10 += exp_negative ? -e : e;
+        tok.is_float = true;
+    }
+    tok.length = i;
+    return true;
+}
+
+// 把 scan_number 扫过的 json 转成最接近的 double；太小的数下溢成 ±0，超出 double 范围（上溢成无穷）时失败
+inline bool number_to_double(std::string_view json, NumberToken const &tok, ParseState &state, double &val)
+{
+    if (tok.digits > 19)
+    {
+        // 尾数超出 64 位，交给标准库做精确转换；语法已经检查过，失败只可能是上溢或下溢
+        if (auto num = try_parse_num<double>(json.substr(0, tok.length)))
+        {
+            val = *num;
+            return true;
+        }
+        // 尾数有 digits 位有效数字，数值小于 1 时一定是下溢，和 decimal_to_double 一样给出 ±0
+        if (int64_t(tok.digits) + tok.exp10 <= 0)
+        {
+            val = tok.negative ? -0.0 : 0.0;
+            return true;
+        }
+        state.fail(ParseErrc::NumberOutOfRange, json.data());
+        return false;
+    }
+    val = decimal_to_double(tok.w, tok.exp10, tok.negative);
+    // 上溢成无穷时失败，下溢已经是 ±0
+    if (std::isinf(val))
+    {
+        state.fail(ParseErrc::NumberOutOfRange, json.data());
+        return false;
+    }
+    return true;
+}
+
+// json 以 '-' 或数字开头，整数范围内的值存为 int，其余存为 double
+template <class Json = JSONObject>
+std::pair<Json, size_t> parse_number(std::string_view json, ParseState &state)
+{
+    BABYJSON_TRACE_SCOPE(Number);
+    NumberToken tok;
+    if (!scan_number(json, state, tok))
+    {
+        return {Json{std::nullptr_t{}}, 0};
+    }
+    if (!tok.is_float && tok.digits <= 19 && tok.w <= (tok.negative ? 2147483648ull : 2147483647ull))
+    {
+        return {Json{int(tok.negative ? -int64_t(tok.w) : int64_t(tok.w))}, tok.length};
+    }
+    double val;
+    if (!number_to_double(json, tok, state, val))
+    {
+        return {Json{std::nullptr_t{}}, 0};
+    }
+    return {Json{val}, tok.length};
+}
+
+// 每个字符串、列表、字典都用 alloc 新建，解析到 basic_json<Allocator>
+template <class Allocator>
+struct AllocatorNodes
+{
+    using json_type = basic_json<Allocator>;
+    using key_slot = typename json_type::string_type;
+
+    Allocator alloc;
+
+    typename json_type::string_type take_string()
+    {
+        return typename json_type::string_type(alloc);
+    }
+
+    typename json_type::list_type take_list()
+    {
+        return typename json_type::list_type(alloc);
+    }
+
+    typename json_type::dict_type take_dict()
+    {
+        return typename json_type::dict_type(alloc);
+    }
+
+    key_slot take_key()
+    {
+        return key_slot(alloc);
+    }
+
+    static key_slot &key_of(key_slot &slot)
+    {
+        return slot;
+    }
+
+    void insert(typename json_type::dict_type &dict, key_slot &&key, json_type &&val)
+    {
+        dict.try_emplace(std::move(key), std::move(val));
+    }
+};
+
+// 默认的节点来源：每个字符串、列表、字典都新建
+using FreshNodes = AllocatorNodes<std::allocator<char>>;
+
+// nodes 提供字符串、列表、字典的存储，见 FreshNodes 和 NodePool；Syntax 见 StrictSyntax
+// 失败时返回 0，原因和位置记在 state 里
+template <class Syntax = StrictSyntax, class Nodes>
+std::pair<typename Nodes::json_type, size_t> parse_value(std::string_view json, ParseOptions const &opts, Nodes &nodes, ParseState &state)
+{
+    using Json = typename Nodes::json_type;
+    auto fail = [&](ParseErrc code, char const *where)
+    {
+        state.fail(code, where);
+        return std::pair<Json, size_t>{Json{std::nullptr_t{}}, 0};
+    };
+    // 跳过 pos 起的空白，没有非空白字符时返回 json.size()
+    auto skip = [&](size_t pos)
+    {
+        size_t off = skip_space<Syntax>(json, pos);
+        return off == json.npos ? json.size() : off;
+    };
+    if (json.empty())
+    {
+        return fail(ParseErrc::UnexpectedEnd, json.data());
+    }
+    else if (size_t off = skip(0); off != 0)
+    {
+        auto [obj, eaten] = parse_value<Syntax>(json.substr(off), opts, nodes, state);
+        if (eaten == 0)
+        {
+            return {Json{std::nullptr_t{}}, 0};
+        }
+        return {std::move(obj), eaten + off};
+    }
+    // 值的总数超限
+    else if (++state.nodes > opts.max_nodes)
+    {
+        return fail(ParseErrc::NodeLimit, json.data());
+    }
+    // 如果是bool或null
+    else if (json[0] == 't' || json[0] == 'f' || json[0] == 'n')
+    {
+        if (json.substr(0, 4) == "true")
+        {
+            return {Json{true}, 4};
+        }
+        if (json.substr(0, 5) == "false")
+        {
+            return {Json{false}, 5};
+        }
+        if (json.substr(0, 4) == "null")
+        {
+            return {Json{std::nullptr_t{}}, 4};
+        }
+        return fail(ParseErrc::InvalidLiteral, json.data());
+    }
+    // 如果是int，double
+    else if (('0' <= json[0] && json[0] <= '9') || json[0] == '-')
+    {
+        return parse_number<Json>(json, state);
+    }
+    // 如果是字符串
+    else if (json[0] == '"')
+    {
+        auto str = nodes.take_string();
+        size_t eaten = parse_string(json, str, opts, state);
+        if (eaten == 0)
+        {
+            return {Json{std::nullptr_t{}}, 0};
+        }
+        return {Json{std::move(str)}, eaten};
+    }
+    // 如果是列表
+    else if (json[0] == '[')
+    {
+        if (++state.depth > opts.max_depth)
+        {
+            return fail(ParseErrc::DepthLimit, json.data());
+        }
+        auto res = nodes.take_list();
+        size_t i = skip(1);
+        if (i < json.size() && json[i] == ']')
+        {
+            state.depth--;
+            return {Json{std::move(res)}, i + 1};
+        }
+        for (;;)
+        {
+            auto [obj, eaten] = parse_value<Syntax>(json.substr(i), opts, nodes, state);
+            if (eaten == 0)
+            {
+                return {Json{std::nullptr_t{}}, 0};
+            }
+            if (res.size() >= opts.max_elements)
+            {
+                return fail(ParseErrc::ElementLimit, json.data() + i);
+            }
+            {
+                BABYJSON_TRACE_SCOPE(Container);
+                res.push_back(std::move(obj));
+            }
+            i = skip(i + eaten);
+            if (i == json.size())
+            {
+                return fail(ParseErrc::UnexpectedEnd, json.data() + i);
+            }
+            if (json[i] == ']')
+            {
+                i += 1;
+                break;
+            }
+            if (json[i] != ',')
+            {
+                return fail(ParseErrc::ExpectedCommaOrBracket, json.data() + i);
+            }
+            i += 1;
+            if constexpr (Syntax::trailing_commas)
+            {
+                i = skip(i);
+                if (i < json.size() && json[i] == ']')
+                {
+                    i += 1;
+                    break;
+                }
+            }
+        }
+        state.depth--;
+        return {Json{std::move(res)}, i};
+    }
+    // 如果是字典
+    else if (json[0] == '{')
+    {
+        if (++state.depth > opts.max_depth)
+        {
+            return fail(ParseErrc::DepthLimit, json.data());
+        }
+        auto res = nodes.take_dict();
+        size_t i = skip(1);
+        if (i < json.size() && json[i] == '}')
+        {
+            state.depth--;
+            return {Json{std::move(res)}, i + 1};
+        }
+        for (size_t count = 0;; count++)
+        {
+            if (i == json.size())
+            {
+                return fail(ParseErrc::UnexpectedEnd, json.data() + i);
+            }
+            if (json[i] != '"')
+            {
+                return fail(ParseErrc::ExpectedKey, json.data() + i);
+            }
+            size_t key_begin = i;
+            auto key = nodes.take_key();
+            size_t keyeaten = parse_string(json.substr(i), Nodes::key_of(key), opts, state);
+            if (keyeaten == 0)
+            {
+                return {Json{std::nullptr_t{}}, 0};
+            }
+            i = skip(i + keyeaten);
+            if (i == json.size())
+            {
+                return fail(ParseErrc::UnexpectedEnd, json.data() + i);
+            }
+            if (json[i] != ':')
+            {
+                return fail(ParseErrc::ExpectedColon, json.data() + i);
+            }
+            i += 1;
+            auto [valobj, valeaten] = parse_value<Syntax>(json.substr(i), opts, nodes, state);
+            if (valeaten == 0)
+            {
+                return {Json{std::nullptr_t{}}, 0};
+            }
+            if (count >= opts.max_elements)
+            {
+                return fail(ParseErrc::ElementLimit, json.data() + key_begin);
+            }
+            {
+                BABYJSON_TRACE_SCOPE(Container);
+                nodes.insert(res, std::move(key), std::move(valobj));
+            }
+            i = skip(i + valeaten);
+            if (i == json.size())
+            {
+                return fail(ParseErrc::UnexpectedEnd, json.data() + i);
+            }
+            if (json[i] == '}')
+            {
+                i += 1;
+                break;
+            }
+            if (json[i] != ',')
+            {
+                return fail(ParseErrc::ExpectedCommaOrBrace, json.data() + i);
+            }
+            i = skip(i + 1);
+            if constexpr (Syntax::trailing_commas)
+            {
+                if (i < json.size() && json[i] == '}')
+                {
+                    i += 1;
+                    break;
+                }
+            }
+        }
+        state.depth--;
+        return {Json{std::move(res)}, i};
+    }
+    return fail(ParseErrc::UnexpectedChar, json.data());
+}
+
+// 解析 json 开头的一个值，后面的内容不管，返回值和吃掉的字节数，失败返回 0
+// 读带注释和末尾逗号的配置文件用 parse<RelaxedSyntax>(json)
+template <class Syntax = StrictSyntax, class Nodes>
+std::pair<typename Nodes::json_type, size_t> parse(std::string_view json, ParseOptions const &opts, Nodes &nodes)
+{
+    ParseState state;
+    return parse_value<Syntax>(json, opts, nodes, state);
+}
+
+template <class Syntax = StrictSyntax>
+std::pair<JSONObject, size_t> parse(std::string_view json, ParseOptions const &opts = {})
+{
+    FreshNodes nodes;
+    return parse<Syntax>(json, opts, nodes);
+}
+
+// 解析完整的文档，值后面只允许空白（Syntax 允许时还有注释）；不抛异常，失败时给出错误码和位置
+template <class Syntax = StrictSyntax, class Nodes>
+basic_parse_result<typename Nodes::json_type> try_parse(std::string_view json, ParseOptions const &opts, Nodes &nodes)
+{
+    ParseState state;
+    auto [obj, eaten] = parse_value<Syntax>(json, opts, nodes, state);
+    if (eaten != 0)
+    {
+        size_t end = skip_space<Syntax>(json, eaten);
+        if (end == json.npos)
+        {
+            return {std::move(obj), eaten, {}};
+        }
+        state.fail(ParseErrc::TrailingCharacters, json.data() + end);
+    }
+    return {typename Nodes::json_type{std::nullptr_t{}}, 0, make_parse_error(json, state.error, size_t(state.error_at - json.data()))};
+}
+
+template <class Syntax = StrictSyntax>
+ParseResult try_parse(std::string_view json, ParseOptions const &opts = {})
+{
+    FreshNodes nodes;
+    return try_parse<Syntax>(json, opts, nodes);
+}
+
+// scan_value 的回调，只拿到原始的词法单元，不解码；各方法都是空的，只做校验时用它
+struct NullHandler
+{
+    void scalar(std::string_view) // 数、true、false、null 的原文
+    {
+    }
+
+    void string(std::string_view) // 含两端引号的原文
+    {
+    }
+
+    void key(std::string_view, size_t) // 字典的键和它是第几个成员
+    {
+    }
+
+    void begin_list()
+    {
+    }
+
+    void element(size_t) // 列表的第 index 个元素开始之前
+    {
+    }
+
+    void end_list(size_t) // 元素个数
+    {
+    }
+
+    void begin_dict()
+    {
+    }
+
+    void end_dict(size_t) // 成员个数
+    {
+    }
+};
+
+// 不建树的 parse_value：按顺序把词法单元交给 handler，字符串只数解码后的长度，数只做转换不存储
+// 规则和错误位置与 parse_value 完全一致，返回吃掉的字节数，失败返回 0
+template <class Syntax = StrictSyntax, class Handler>
+size_t scan_value(std::string_view json, ParseOptions const &opts, ParseState &state, Handler &handler)
+{
+    auto fail = [&](ParseErrc code, char const *where)
+    {
+        state.fail(code, where);
+        return size_t(0);
+    };
+    auto skip = [&](size_t pos)
+    {
+        size_t off = skip_space<Syntax>(json, pos);
+        return off == json.npos ? json.size() : off;
+    };
+    if (json.empty())
+    {
+        return fail(ParseErrc::UnexpectedEnd, json.data());
+    }
+    else if (size_t off = skip(0); off != 0)
+    {
+        size_t eaten = scan_value<Syntax>(json.substr(off), opts, state, handler);
+        return eaten == 0 ? 0 : eaten + off;
+    }
+    else if (++state.nodes > opts.max_nodes)
+    {
+        return fail(ParseErrc::NodeLimit, json.data());
+    }
+    else if (json[0] == 't' || json[0] == 'f' || json[0] == 'n')
+    {
+        size_t eaten = json.substr(0, 4) == "true" || json.substr(0, 4) == "null" ? 4 : json.substr(0, 5) == "false" ? 5 : 0;
+        if (eaten == 0)
+        {
+            return fail(ParseErrc::InvalidLiteral, json.data());
+        }
+        handler.scalar(json.substr(0, eaten));
+        return eaten;
+    }
+    else if (('0' <= json[0] && json[0] <= '9') || json[0] == '-')
+    {
+        // 超出范围的数也要报错，所以仍然转换一次，JSONObject 里只有 int 或 double，不分配内存
+        size_t eaten = parse_number(json, state).second;
+        if (eaten != 0)
+        {
+            handler.scalar(json.substr(0, eaten));
+        }
+        return eaten;
+    }
+    else if (json[0] == '"')
+    {
+        StringLength len;
+        size_t eaten = parse_string(json, len, opts, state);
+        if (eaten != 0)
+        {
+            handler.string(json.substr(0, eaten));
+        }
+        return eaten;
+    }
+    else if (json[0] == '[' || json[0] == '{')
+    {
+        bool is_list = json[0] == '[';
+        char close = is_list ? ']' : '}';
+        if (++state.depth > opts.max_depth)
+        {
+            return fail(ParseErrc::DepthLimit, json.data());
+        }
+        is_list ? handler.begin_list() : handler.begin_dict();
+        size_t count = 0;
+        size_t i = skip(1);
+        if (i < json.size() && json[i] == close)
+        {
+            i += 1;
+        }
+        else
+        {
+            for (;; count++)
+            {
+                size_t elem_begin = i;
+                if (is_list)
+                {
+                    handler.element(count);
+                }
+                else
+                {
+                    if (i == json.size())
+                    {
+                        return fail(ParseErrc::UnexpectedEnd, json.data() + i);
+                    }
+                    if (json[i] != '"')
+                    {
+                        return fail(ParseErrc::ExpectedKey, json.data() + i);
+                    }
+                    StringLength key;
+                    size_t keyeaten = parse_string(json.substr(i), key, opts, state);
+                    if (keyeaten == 0)
+                    {
+                        return 0;
+                    }
+                    handler.key(json.substr(i, keyeaten), count);
+                    i = skip(i + keyeaten);
+                    if (i == json.size())
+                    {
+                        return fail(ParseErrc::UnexpectedEnd, json.data() + i);
+                    }
+                    if (json[i] != ':')
+                    {
+                        return fail(ParseErrc::ExpectedColon, json.data() + i);
+                    }
+                    i += 1;
+                }
+                size_t eaten = scan_value<Syntax>(json.substr(i), opts, state, handler);
+                if (eaten == 0)
+                {
+                    return 0;
+                }
+                if (count >= opts.max_elements)
+                {
+                    return fail(ParseErrc::ElementLimit, json.data() + elem_begin);
+                }
+                i = skip(i + eaten);
+                if (i == json.size())
+                {
+                    return fail(ParseErrc::UnexpectedEnd, json.data() + i);
+                }
+                if (json[i] == close)
+                {
+                    i += 1;
+                    count++;
+                    break;
+                }
+                if (json[i] != ',')
+                {
+                    return fail(is_list ? ParseErrc::ExpectedCommaOrBracket : ParseErrc::ExpectedCommaOrBrace, json.data() + i);
+                }
+                if constexpr (Syntax::trailing_commas)
+                {
+                    i = skip(i + 1);
+                    if (i < json.size() && json[i] == close)
+                    {
+                        i += 1;
+                        count++;
+                        break;
+                    }
+                }
+                else
+                {
+                    i = is_list ? i + 1 : skip(i + 1);
+                }
+            }
+        }
+        is_list ? handler.end_list(count) : handler.end_dict(count);
+        state.depth--;
+        return i;
+    }
+    return fail(ParseErrc::UnexpectedChar, json.data());
+}
+
+// 扫描完整的文档，值后面只允许空白（Syntax 允许时还有注释）
+template <class Syntax = StrictSyntax, class Handler>
+ParseError scan(std::string_view json, ParseOptions const &opts, Handler &handler)
+{
+    ParseState state;
+    size_t eaten = scan_value<Syntax>(json, opts, state, handler);
+    if (eaten != 0)
+    {
+        size_t end = skip_space<Syntax>(json, eaten);
+        if (end == json.npos)
+        {
+            return {};
+        }
+        state.fail(ParseErrc::TrailingCharacters, json.data() + end);
+    }
+    return make_parse_error(json, state.error, size_t(state.error_at - json.data()));
+}
+
+// 只判断 json 是否是合法的完整文档，不构造 JSONObject；返回的 code 为 Ok 表示合法
+template <class Syntax = StrictSyntax>
+ParseError validate(std::string_view json, ParseOptions const &opts = {})
+{
+    NullHandler handler;
+    return scan<Syntax>(json, opts, handler);
+}
+
+// 原样拷贝词法单元、去掉所有空白
+struct MinifyHandler : NullHandler
+{
+    std::string &out;
+
+    explicit MinifyHandler(std::string &out_) : out(out_)
+    {
+    }
+
+    void scalar(std::string_view raw)
+    {
+        out += raw;
+    }
+
+    void string(std::string_view raw)
+    {
+        out += raw;
+    }
+
+    void key(std::string_view raw, size_t index)
+    {
+        if (index != 0)
+        {
+            out += ',';
+        }
+        out += raw;
+        out += ':';
+    }
+
+    void begin_list()
+    {
+        out += '[';
+    }
+
+    void element(size_t index)
+    {
+        if (index != 0)
+        {
+            out += ',';
+        }
+    }
+
+    void end_list(size_t)
+    {
+        out += ']';
+    }
+
+    void begin_dict()
+    {
+        out += '{';
+    }
+
+    void end_dict(size_t)
+    {
+        out += '}';
+    }
+};
+
+// 原样拷贝词法单元，每个元素、成员单独一行，每层缩进 indent 个空格，空容器写成 [] 和 {}
+struct PrettifyHandler : MinifyHandler
+{
+    size_t indent;
+    size_t level = 0;
+
+    PrettifyHandler(std::string &out_, size_t indent_) : MinifyHandler(out_), indent(indent_)
+    {
+    }
+
+    void newline()
+    {
+        out += '\n';
+        out.append(level * indent, ' ');
+    }
+
+    void key(std::string_view raw, size_t index)
+    {
+        if (index != 0)
+        {
+            out += ',';
+        }
+        newline();
+        out += raw;
+        out += ": ";
+    }
+
+    void begin_list()
+    {
+        out += '[';
+        level++;
+    }
+
+    void element(size_t index)
+    {
+        if (index != 0)
+        {
+            out += ',';
+        }
+        newline();
+    }
+
+    void end_list(size_t count)
+    {
+        level--;
+        if (count != 0)
+        {
+            newline();
+        }
+        out += ']';
+    }
+
+    void begin_dict()
+    {
+        out += '{';
+        level++;
+    }
+
+    void end_dict(size_t count)
+    {
+        level--;
+        if (count != 0)
+        {
+            newline();
+        }
+        out += '}';
+    }
+};
+
+// 去掉 json 里的空白后追加到 out，字符串和数原样拷贝，不重新转义；不合法时返回错误，out 保持不变
+// minify<RelaxedSyntax> 同时去掉注释和末尾逗号，得到严格的 JSON
+template <class Syntax = StrictSyntax>
+ParseError minify(std::string_view json, std::string &out, ParseOptions const &opts = {})
+{
+    size_t old_size = out.size();
+    MinifyHandler handler(out);
+    ParseError err = scan<Syntax>(json, opts, handler);
+    if (err.code != ParseErrc::Ok)
+    {
+        out.resize(old_size);
+    }
+    return err;
+}
+
+// 按每层 indent 个空格重新排版后追加到 out，其余同 minify
+template <class Syntax = StrictSyntax>
+ParseError prettify(std::string_view json, std::string &out, size_t indent = 4, ParseOptions const &opts = {})
+{
+    size_t old_size = out.size();
+    PrettifyHandler handler(out, indent);
+    ParseError err = scan<Syntax>(json, opts, handler);
+    if (err.code != ParseErrc::Ok)
+    {
+        out.resize(old_size);
+    }
+    return err;
+}
+
+// 回收旧文档里的字符串、列表和字典节点，保留它们的容量供下次解析复用
+// 回收顺序与解析时取用的顺序一致，形状相近的消息能拿到大小合适的容器
+class NodePool
+{
+public:
+    using json_type = JSONObject;
+    using key_slot = JSONDict::node_type;
+
+    void recycle(JSONObject &obj)
+    {
+        if (auto *str = std::get_if<std::string>(&obj.inner))
+        {
+            strings.push_back(std::move(*str));
+        }
+        else if (auto *list = std::get_if<JSONList>(&obj.inner))
+        {
+            // 逆序回收，栈顶才是下次解析最先取用的那个
+            for (auto it = list->rbegin(); it != list->rend(); ++it)
+            {
+                recycle(*it);
+            }
+            list->clear();
+            lists.push_back(std::move(*list));
+        }
+        else if (auto *dict = std::get_if<JSONDict>(&obj.inner))
+        {
+            while (!dict->empty())
+            {
+                auto node = dict->extract(dict->begin());
+                recycle(node.mapped());
+                nodes.push_back(std::move(node));
+            }
+            dicts.push_back(std::move(*dict));
+        }
+    }
+
+    std::string take_string()
+    {
+        return take(strings);
+    }
+
+    JSONList take_list()
+    {
+        return take(lists);
+    }
+
+    JSONDict take_dict()
+    {
+        return take(dicts);
+    }
+
+    key_slot take_key()
+    {
+        if (nodes.empty())
+        {
+            // 池空时借一个临时字典造出节点
+            JSONDict tmp;
+            tmp.try_emplace(std::string());
+            return tmp.extract(tmp.begin());
+        }
+        key_slot node = std::move(nodes.back());
+        nodes.pop_back();
+        node.key().clear();
+        return node;
+    }
+
+    static std::string &key_of(key_slot &slot)
+    {
+        return slot.key();
+    }
+
+    void insert(JSONDict &dict, key_slot &&key, JSONObject &&val)
+    {
+        key.mapped() = std::move(val);
+        auto res = dict.insert(std::move(key));
+        if (!res.inserted)
+        {
+            // 重复的键保留第一个，节点放回池里
+            recycle(res.node.mapped());
+            nodes.push_back(std::move(res.node));
+        }
+    }
+
+private:
+    template <class T>
+    static T take(std::vector<T> &pool)
+    {
+        if (pool.empty())
+        {
+            return T{};
+        }
+        T res = std::move(pool.back());
+        pool.pop_back();
+        res.clear();
+        return res;
+    }
+
+    std::vector<std::string> strings;
+    std::vector<JSONList> lists;
+    std::vector<JSONDict> dicts;
+    std::vector<JSONDict::node_type> nodes;
+};
+
+// 可复用的文档：每次解析前回收上一次的树，同样形状的消息反复解析时稳态下不再分配堆内存
+struct Document
+{
+    JSONObject root;
+    ParseOptions opts;
+    ParseError error; // 最近一次解析的结果，成功时 code 为 Ok
+
+    // 解析完整的文档 json 替换 root，返回吃掉的字节数，0 表示失败，原因见 error
+    size_t parse(std::string_view json)
+    {
+        pool.recycle(root);
+        ParseResult res = try_parse(json, opts, pool);
+        root = std::move(res.value);
+        error = res.error;
+        return res.eaten;
+    }
+
+private:
+    NodePool pool;
+};
+
+//模版推导指导
+template <class... Fs>
+struct overloaded : Fs...
+{
+    using Fs::operator()...;
+};
+
+template <class... Fs>
+overloaded(Fs...) -> overloaded<Fs...>;
+
+// 把 str 加上引号并转义后追加到 out，不需要转义的片段整块拷贝
+inline void escape_string(std::string_view str, std::string &out)
+{
+    out.reserve(out.size() + str.size() + 2);
+    out += '"';
+    size_t i = 0;
+    while (i < str.size())
+    {
+        size_t run = find_escape_needed(str.data() + i, str.size() - i);
+        out.append(str.data() + i, run);
+        i += run;
+        if (i >= str.size())
+        {
+            break;
+        }
+        unsigned char ch = static_cast<unsigned char>(str[i++]);
+        switch (ch)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        default:
+        {
+            static char const hex[] = "0123456789abcdef";
+            char buf[6] = {'\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF]};
+            out.append(buf, 6);
+        }
+        }
+    }
+    out += '"';
+}
+
+// 序列化为紧凑的 JSON 文本，追加到 out
+template <class Allocator>
+void dump(basic_json<Allocator> const &obj, std::string &out)
+{
+    std::visit(
+        overloaded{
+            [&](std::nullptr_t)
+            {
+                out += "null";
+            },
+            [&](bool val)
+            {
+                out += val ? "true" : "false";
+            },
+            [&](int val)
+            {
+                char buf[16];
+                auto res = std::to_chars(buf, buf + sizeof(buf), val);
+                out.append(buf, res.ptr);
+            },
+            [&](double val)
+            {
+                // JSON 里没有 NaN 和无穷大
+                if (!std::isfinite(val))
+                {
+                    out += "null";
+                    return;
+                }
+                char buf[32];
+                out.append(buf, double_to_chars(val, buf));
+            },
+            [&](typename basic_json<Allocator>::string_type const &val)
+            {
+                escape_string(val, out);
+            },
+            [&](typename basic_json<Allocator>::list_type const &list)
+            {
+                out += '[';
+                bool once = false;
+                for (auto const &v : list)
+                {
+                    if (once)
+                    {
+                        out += ',';
+                    }
+                    once = true;
+                    dump(v, out);
+                }
+                out += ']';
+            },
+            [&](typename basic_json<Allocator>::dict_type const &dict)
+            {
+                out += '{';
+                bool once = false;
+                for (auto const &[k, v] : dict)
+                {
+                    if (once)
+                    {
+                        out += ',';
+                    }
+                    once = true;
+                    escape_string(k, out);
+                    out += ':';
+                    dump(v, out);
+                }
+                out += '}';
+            }},
+        obj.inner);
+}
+
+template <class Allocator>
+std::string dump(basic_json<Allocator> const &obj)
+{
+    std::string out;
+    dump(obj, out);
+    return out;
+}
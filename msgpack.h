@@ -0,0 +1,420 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "json.h"
+
+// JSONObject 和 MessagePack 互转，见 https://github.com/msgpack/msgpack/blob/master/spec.md
+// 整数取最短的编码，double 一律写成 float64；bin、ext 和非字符串的键没有对应的 JSONObject，解码时视为错误
+
+namespace _msgpack_details {
+    inline void put_be(std::string &out, uint64_t v, size_t n)
+    {
+        char buf[8];
+        for (size_t i = 0; i < n; i++)
+        {
+            buf[i] = char(v >> (8 * (n - 1 - i)));
+        }
+        out.append(buf, n);
+    }
+
+    inline uint64_t get_be(unsigned char const *p, size_t n)
+    {
+        uint64_t v = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            v = (v << 8) | p[i];
+        }
+        return v;
+    }
+
+    // 长度不超过 fix_max 时写进 fix 的低位，否则依次用 8、16、32 位长度；tag8 为 0 表示没有 8 位的形式
+    // MessagePack 的长度最多 32 位，超出时返回 false，不写入
+    inline bool put_head(std::string &out, unsigned char fix, size_t fix_max, unsigned char tag8, unsigned char tag16, size_t n)
+    {
+        if (uint64_t(n) > 0xFFFFFFFF)
+        {
+            return false;
+        }
+        if (n <= fix_max)
+        {
+            out += char(fix | n);
+        }
+        else if (tag8 != 0 && n <= 0xFF)
+        {
+            out += char(tag8);
+            put_be(out, n, 1);
+        }
+        else if (n <= 0xFFFF)
+        {
+            out += char(tag16);
+            put_be(out, n, 2);
+        }
+        else
+        {
+            out += char(tag16 + 1);
+            put_be(out, n, 4);
+        }
+        return true;
+    }
+
+    inline bool encode(JSONObject const &obj, std::string &out)
+    {
+        return std::visit(
+            overloaded{
+                [&](std::nullptr_t)
+                {
+                    out += char(0xC0);
+                    return true;
+                },
+                [&](bool val)
+                {
+                    out += char(val ? 0xC3 : 0xC2);
+                    return true;
+                },
+                [&](int val)
+                {
+                    if (-32 <= val && val <= 127)
+                    {
+                        out += char(val);
+                    }
+                    else if (val > 0)
+                    {
+                        size_t n = val <= 0xFF ? 1 : val <= 0xFFFF ? 2 : 4;
+                        out += char(n == 1 ? 0xCC : n == 2 ? 0xCD : 0xCE);
+                        put_be(out, uint64_t(val), n);
+                    }
+                    else
+                    {
+                        size_t n = val >= -128 ? 1 : val >= -32768 ? 2 : 4;
+                        out += char(n == 1 ? 0xD0 : n == 2 ? 0xD1 : 0xD2);
+                        put_be(out, uint64_t(int64_t(val)), n);
+                    }
+                    return true;
+                },
+                [&](double val)
+                {
+                    uint64_t bits;
+                    std::memcpy(&bits, &val, 8);
+                    out += char(0xCB);
+                    put_be(out, bits, 8);
+                    return true;
+                },
+                [&](std::string const &val)
+                {
+                    // str8 (0xD9) 在最早的规范里没有，这里照常使用
+                    if (!put_head(out, 0xA0, 31, 0xD9, 0xDA, val.size()))
+                    {
+                        return false;
+                    }
+                    out += val;
+                    return true;
+                },
+                [&](JSONList const &val)
+                {
+                    if (!put_head(out, 0x90, 15, 0, 0xDC, val.size()))
+                    {
+                        return false;
+                    }
+                    for (auto const &v : val)
+                    {
+                        if (!encode(v, out))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                },
+                [&](JSONDict const &val)
+                {
+                    if (!put_head(out, 0x80, 15, 0, 0xDE, val.size()))
+                    {
+                        return false;
+                    }
+                    for (auto const &[k, v] : val)
+                    {
+                        if (!put_head(out, 0xA0, 31, 0xD9, 0xDA, k.size()))
+                        {
+                            return false;
+                        }
+                        out += k;
+                        if (!encode(v, out))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                },
+            },
+            obj.inner);
+    }
+
+    struct _decoder
+    {
+        unsigned char const *p;
+        unsigned char const *end;
+        ParseOptions const &opts;
+        ParseState state;
+
+        bool need(size_t n) const
+        {
+            return size_t(end - p) >= n;
+        }
+
+        // 读出 n 字节的大端无符号整数，数据不够返回 false
+        bool read(size_t n, uint64_t &v)
+        {
+            if (!need(n))
+            {
+                return false;
+            }
+            v = get_be(p, n);
+            p += n;
+            return true;
+        }
+
+        static JSONObject from_int(int64_t v)
+        {
+            // 和 parse 一样，超出 int 的整数存为 double
+            if (INT32_MIN <= v && v <= INT32_MAX)
+            {
+                return JSONObject{int(v)};
+            }
+            return JSONObject{double(v)};
+        }
+
+        // 字符串直接从输入整段拷进 std::string
+        bool string(size_t n, std::string &str)
+        {
+            if (!need(n) || n > opts.max_string_length)
+            {
+                return false;
+            }
+            if (opts.validate_utf8 && !utf8_validate(reinterpret_cast<char const *>(p), n))
+            {
+                return false;
+            }
+            str.assign(reinterpret_cast<char const *>(p), n);
+            p += n;
+            return true;
+        }
+
+        // 读出字符串的长度，不是字符串返回 false
+        bool string_head(size_t &n)
+        {
+            if (!need(1))
+            {
+                return false;
+            }
+            unsigned char tag = *p++;
+            uint64_t v;
+            if ((tag & 0xE0) == 0xA0)
+            {
+                n = tag & 0x1F;
+                return true;
+            }
+            if (tag < 0xD9 || tag > 0xDB || !read(size_t(1) << (tag - 0xD9), v))
+            {
+                return false;
+            }
+            n = size_t(v);
+            return true;
+        }
+
+        bool value(JSONObject &out)
+        {
+            if (!need(1) || ++state.nodes > opts.max_nodes)
+            {
+                return false;
+            }
+            unsigned char tag = *p++;
+            uint64_t v;
+            if (tag <= 0x7F)
+            {
+                out = JSONObject{int(tag)};
+            }
+            else if (tag >= 0xE0)
+            {
+                out = JSONObject{int(int8_t(tag))};
+            }
+            else if ((tag & 0xE0) == 0xA0 || (0xD9 <= tag && tag <= 0xDB))
+            {
+                p--;
+                size_t n;
+                std::string str;
+                if (!string_head(n) || !string(n, str))
+                {
+                    return false;
+                }
+                out = JSONObject{std::move(str)};
+            }
+            else if ((tag & 0xF0) == 0x90)
+            {
+                return list(tag & 0x0F, out);
+            }
+            else if (tag == 0xDC || tag == 0xDD)
+            {
+                return read(tag == 0xDC ? 2 : 4, v) && list(size_t(v), out);
+            }
+            else if ((tag & 0xF0) == 0x80)
+            {
+                return dict(tag & 0x0F, out);
+            }
+            else if (tag == 0xDE || tag == 0xDF)
+            {
+                return read(tag == 0xDE ? 2 : 4, v) && dict(size_t(v), out);
+            }
+            else
+            {
+                switch (tag)
+                {
+                case 0xC0:
+                    out = JSONObject{std::nullptr_t{}};
+                    break;
+                case 0xC2:
+                case 0xC3:
+                    out = JSONObject{tag == 0xC3};
+                    break;
+                case 0xCA:
+                {
+                    if (!read(4, v))
+                    {
+                        return false;
+                    }
+                    uint32_t bits = uint32_t(v);
+                    float f;
+                    std::memcpy(&f, &bits, 4);
+                    out = JSONObject{double(f)};
+                    break;
+                }
+                case 0xCB:
+                {
+                    if (!read(8, v))
+                    {
+                        return false;
+                    }
+                    double d;
+                    std::memcpy(&d, &v, 8);
+                    out = JSONObject{d};
+                    break;
+                }
+                case 0xCC:
+                case 0xCD:
+                case 0xCE:
+                case 0xCF:
+                    if (!read(size_t(1) << (tag - 0xCC), v))
+                    {
+                        return false;
+                    }
+                    out = v > uint64_t(INT64_MAX) ? JSONObject{double(v)} : from_int(int64_t(v));
+                    break;
+                case 0xD0:
+                case 0xD1:
+                case 0xD2:
+                case 0xD3:
+                {
+                    size_t n = size_t(1) << (tag - 0xD0);
+                    if (!read(n, v))
+                    {
+                        return false;
+                    }
+                    // 符号扩展
+                    int64_t s = n == 8 ? int64_t(v) : int64_t(v << (64 - 8 * n)) >> (64 - 8 * n);
+                    out = from_int(s);
+                    break;
+                }
+                default:
+                    // 0xC1 未使用，bin 和 ext 不支持
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool list(size_t n, JSONObject &out)
+        {
+            if (++state.depth > opts.max_depth || n > opts.max_elements)
+            {
+                return false;
+            }
+            JSONList res;
+            // 每个元素至少一个字节，长度字段不可信时不会多分配
+            res.reserve(std::min(n, size_t(end - p)));
+            for (size_t i = 0; i < n; i++)
+            {
+                res.emplace_back();
+                if (!value(res.back()))
+                {
+                    return false;
+                }
+            }
+            state.depth--;
+            out = JSONObject{std::move(res)};
+            return true;
+        }
+
+        bool dict(size_t n, JSONObject &out)
+        {
+            if (++state.depth > opts.max_depth || n > opts.max_elements)
+            {
+                return false;
+            }
+            JSONDict res;
+            res.reserve(std::min(n, size_t(end - p) / 2));
+            std::string key;
+            for (size_t i = 0; i < n; i++)
+            {
+                size_t len;
+                JSONObject val;
+                if (!string_head(len) || !string(len, key) || !value(val))
+                {
+                    return false;
+                }
+                res.try_emplace(std::move(key), std::move(val));
+            }
+            state.depth--;
+            out = JSONObject{std::move(res)};
+            return true;
+        }
+    };
+}
+
+// 把 obj 编码成 MessagePack 追加到 out；有字符串、列表或字典的长度达到 2^32 时返回 false，out 保持原样
+inline bool msgpack_encode(JSONObject const &obj, std::string &out)
+{
+    size_t old_size = out.size();
+    if (!_msgpack_details::encode(obj, out))
+    {
+        out.resize(old_size);
+        return false;
+    }
+    return true;
+}
+
+// 同上，失败返回 nullopt
+inline std::optional<std::string> msgpack_encode(JSONObject const &obj)
+{
+    std::string out;
+    if (!msgpack_encode(obj, out))
+    {
+        return std::nullopt;
+    }
+    return out;
+}
+
+// 解码 data 开头的一个 MessagePack 值，返回值和吃掉的字节数，失败返回 0；opts 里的限制同样生效
+inline std::pair<JSONObject, size_t> msgpack_decode(std::string_view data, ParseOptions const &opts = {})
+{
+    auto begin = reinterpret_cast<unsigned char const *>(data.data());
+    _msgpack_details::_decoder dec{begin, begin + data.size(), opts, {}};
+    JSONObject res;
+    if (!dec.value(res))
+    {
+        return {JSONObject{std::nullptr_t{}}, 0};
+    }
+    return {std::move(res), size_t(dec.p - begin)};
+}
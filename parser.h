@@ -0,0 +1,554 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "json.h"
+
+// 按策略在编译期定制的解析器：数怎么存、字符串拷贝还是引用输入、字典用哈希表还是平铺的数组、语法和限制
+// 每种组合各自实例化一份代码，用不到的分支在编译期就去掉了，语法和错误码、错误位置与 try_parse 一致
+//
+//     struct ConfigPolicy : DefaultParsePolicy
+//     {
+//         using syntax = RelaxedSyntax;
+//         using strings = StringViews;
+//         using dict = FlatDict;
+//     };
+//     basic_parser<ConfigPolicy> parser;
+//     auto res = parser.parse(text);
+
+// 数的存法
+struct NumbersAsIntOrDouble // int 范围内的整数存为 int，其余存为 double，同 parse
+{
+};
+
+struct NumbersAsInt64OrDouble // int64_t 范围内的整数存为 int64_t，其余存为 double
+{
+};
+
+struct NumbersAsDouble // 一律存为 double
+{
+};
+
+struct NumbersAsRaw // 只检查语法，保留原文，不转换也不检查范围
+{
+};
+
+// NumbersAsRaw 下的数，指向输入里的原文
+struct RawNumber
+{
+    std::string_view text;
+
+    bool operator==(RawNumber const &other) const
+    {
+        return text == other.text;
+    }
+};
+
+// 字符串的存法
+struct OwnedStrings // 解码到 std::string
+{
+};
+
+struct StringViews // std::string_view：没有转义的直接指向输入，有转义的解码到解析器持有的缓冲区
+{
+};
+
+// 字典的存法
+struct HashDict // std::unordered_map，重复的键保留第一个，同 parse
+{
+};
+
+struct FlatDict // 按出现顺序存成 std::vector<std::pair<键, 值>>，重复的键都保留，find 取第一个
+{
+};
+
+// 和 parse 的行为相同，定制时继承它再改需要的几项
+struct DefaultParsePolicy
+{
+    using syntax = StrictSyntax;
+    using numbers = NumbersAsIntOrDouble;
+    using strings = OwnedStrings;
+    using dict = HashDict;
+    static constexpr ParseOptions options{}; // 限制和 UTF-8 校验
+};
+
+namespace _parser_details {
+    template <class... Ts>
+    struct type_list
+    {
+    };
+
+    template <class Numbers>
+    struct number_types;
+
+    template <>
+    struct number_types<NumbersAsIntOrDouble>
+    {
+        using type = type_list<int, double>;
+    };
+
+    template <>
+    struct number_types<NumbersAsInt64OrDouble>
+    {
+        using type = type_list<int64_t, double>;
+    };
+
+    template <>
+    struct number_types<NumbersAsDouble>
+    {
+        using type = type_list<double>;
+    };
+
+    template <>
+    struct number_types<NumbersAsRaw>
+    {
+        using type = type_list<RawNumber>;
+    };
+
+    template <class Strings>
+    struct string_type;
+
+    template <>
+    struct string_type<OwnedStrings>
+    {
+        using type = std::string;
+    };
+
+    template <>
+    struct string_type<StringViews>
+    {
+        using type = std::string_view;
+    };
+
+    template <class Dict, class Key, class Value>
+    struct dict_type;
+
+    template <class Key, class Value>
+    struct dict_type<HashDict, Key, Value>
+    {
+        using type = std::unordered_map<Key, Value>;
+    };
+
+    template <class Key, class Value>
+    struct dict_type<FlatDict, Key, Value>
+    {
+        using type = std::vector<std::pair<Key, Value>>;
+    };
+
+    template <class Numbers, class... Rest>
+    struct make_variant;
+
+    template <class... Ns, class... Rest>
+    struct make_variant<type_list<Ns...>, Rest...>
+    {
+        using type = std::variant<std::nullptr_t, bool, Ns..., Rest...>;
+    };
+}
+
+// basic_parser 的结果，和 JSONObject 一样是一个 variant，备选类型由 Policy 决定
+template <class Policy>
+struct basic_value
+{
+    using string_type = typename _parser_details::string_type<typename Policy::strings>::type;
+    using list_type = std::vector<basic_value>;
+    using dict_type = typename _parser_details::dict_type<typename Policy::dict, string_type, basic_value>::type;
+
+    typename _parser_details::make_variant<typename _parser_details::number_types<typename Policy::numbers>::type,
+                                           string_type, list_type, dict_type>::type inner;
+
+    template <class T>
+    bool is() const
+    {
+        return std::holds_alternative<T>(inner);
+    }
+
+    template <class T>
+    T const &get() const
+    {
+        return std::get<T>(inner);
+    }
+
+    template <class T>
+    T &get()
+    {
+        return std::get<T>(inner);
+    }
+
+    // 在字典里查找 key，不是字典或找不到时返回 nullptr
+    basic_value const *find(std::string_view key) const
+    {
+        auto dict = std::get_if<dict_type>(&inner);
+        if (dict == nullptr)
+        {
+            return nullptr;
+        }
+        if constexpr (std::is_same_v<typename Policy::dict, FlatDict>)
+        {
+            for (auto const &[k, v] : *dict)
+            {
+                if (k == key)
+                {
+                    return &v;
+                }
+            }
+            return nullptr;
+        }
+        else
+        {
+            auto it = dict->find(string_type(key));
+            return it == dict->end() ? nullptr : &it->second;
+        }
+    }
+
+    bool operator==(basic_value const &other) const
+    {
+        return inner == other.inner;
+    }
+
+    bool operator!=(basic_value const &other) const
+    {
+        return inner != other.inner;
+    }
+};
+
+template <class Policy = DefaultParsePolicy>
+class basic_parser
+{
+public:
+    using value_type = basic_value<Policy>;
+
+    using result = basic_parse_result<value_type>;
+
+    // 解析完整的文档，值后面只允许空白（syntax 允许时还有注释），同 try_parse
+    // StringViews 下结果引用 json 和本解析器的缓冲区，两者都要保持到下一次 parse 之前
+    result parse(std::string_view json)
+    {
+        decoded.clear();
+        ParseState state;
+        value_type val;
+        size_t end = value(json, 0, val, state);
+        if (end != 0)
+        {
+            size_t rest = skip_space<syntax>(json, end);
+            if (rest == json.npos)
+            {
+                return {std::move(val), end, {}};
+            }
+            state.fail(ParseErrc::TrailingCharacters, json.data() + rest);
+        }
+        return {value_type{}, 0, make_parse_error(json, state.error, size_t(state.error_at - json.data()))};
+    }
+
+private:
+    using syntax = typename Policy::syntax;
+    using numbers = typename Policy::numbers;
+    using string_type = typename value_type::string_type;
+    using list_type = typename value_type::list_type;
+    using dict_type = typename value_type::dict_type;
+    static constexpr ParseOptions const &opts = Policy::options;
+
+    // 跳过 pos 起的空白，没有非空白字符时返回 json.size()
+    static size_t skip(std::string_view json, size_t pos)
+    {
+        size_t off = skip_space<syntax>(json, pos);
+        return off == json.npos ? json.size() : off;
+    }
+
+    static size_t fail(ParseState &state, ParseErrc code, char const *where)
+    {
+        state.fail(code, where);
+        return 0;
+    }
+
+    // json[i] 是 '"'，返回字符串之后的位置，失败返回 0
+    size_t string(std::string_view json, size_t i, string_type &out, ParseState &state)
+    {
+        if constexpr (std::is_same_v<typename Policy::strings, StringViews>)
+        {
+            // 没有转义时直接引用输入，检查的顺序和 parse_string 相同
+            size_t run = find_escape_needed(json.data() + i + 1, json.size() - i - 1);
+            size_t close = i + 1 + run;
+            if (close < json.size() && json[close] == '"')
+            {
+                std::string_view str = json.substr(i + 1, run);
+                if (str.size() > opts.max_string_length)
+                {
+                    return fail(state, ParseErrc::StringLimit, json.data() + i);
+                }
+                if (opts.validate_utf8 && !utf8_validate(str))
+                {
+                    return fail(state, ParseErrc::InvalidUtf8, str.data() + utf8_first_invalid(str));
+                }
+                out = str;
+                return close + 1;
+            }
+            std::string &buf = decoded.emplace_back();
+            size_t eaten = parse_string(json.substr(i), buf, opts, state);
+            out = buf;
+            return eaten == 0 ? 0 : i + eaten;
+        }
+        else
+        {
+            size_t eaten = parse_string(json.substr(i), out, opts, state);
+            return eaten == 0 ? 0 : i + eaten;
+        }
+    }
+
+    static size_t number(std::string_view json, size_t i, value_type &out, ParseState &state)
+    {
+        std::string_view num = json.substr(i);
+        NumberToken tok;
+        if (!scan_number(num, state, tok))
+        {
+            return 0;
+        }
+        if constexpr (std::is_same_v<numbers, NumbersAsRaw>)
+        {
+            out.inner = RawNumber{num.substr(0, tok.length)};
+            return i + tok.length;
+        }
+        else
+        {
+            if constexpr (std::is_same_v<numbers, NumbersAsIntOrDouble>)
+            {
+                if (!tok.is_float && tok.digits <= 19 && tok.w <= (tok.negative ? 2147483648ull : 2147483647ull))
+                {
+                    out.inner = int(tok.negative ? -int64_t(tok.w) : int64_t(tok.w));
+                    return i + tok.length;
+                }
+            }
+            else if constexpr (std::is_same_v<numbers, NumbersAsInt64OrDouble>)
+            {
+                if (!tok.is_float && tok.digits <= 19 && tok.w <= (tok.negative ? 9223372036854775808ull : 9223372036854775807ull))
+                {
+                    out.inner = tok.negative ? -int64_t(tok.w - 1) - 1 : int64_t(tok.w);
+                    return i + tok.length;
+                }
+            }
+            double val;
+            if (!number_to_double(num, tok, state, val))
+            {
+                return 0;
+            }
+            out.inner = val;
+            return i + tok.length;
+        }
+    }
+
+    // 解析 json[i] 起的一个值写进 out，返回值之后的位置，失败返回 0
+    size_t value(std::string_view json, size_t i, value_type &out, ParseState &state)
+    {
+        i = skip(json, i);
+        if (i == json.size())
+        {
+            return fail(state, ParseErrc::UnexpectedEnd, json.data() + i);
+        }
+        if (++state.nodes > opts.max_nodes)
+        {
+            return fail(state, ParseErrc::NodeLimit, json.data() + i);
+        }
+        switch (json[i])
+        {
+        case 't':
+        case 'f':
+        case 'n':
+        {
+            std::string_view rest = json.substr(i);
+            if (rest.substr(0, 4) == "true")
+            {
+                out.inner = true;
+                return i + 4;
+            }
+            if (rest.substr(0, 5) == "false")
+            {
+                out.inner = false;
+                return i + 5;
+            }
+            if (rest.substr(0, 4) == "null")
+            {
+                out.inner = nullptr;
+                return i + 4;
+            }
+            return fail(state, ParseErrc::InvalidLiteral, json.data() + i);
+        }
+        case '"':
+        {
+            string_type str;
+            size_t end = string(json, i, str, state);
+            if (end != 0)
+            {
+                out.inner = std::move(str);
+            }
+            return end;
+        }
+        case '[':
+            return list(json, i, out, state);
+        case '{':
+            return dict(json, i, out, state);
+        default:
+            if (('0' <= json[i] && json[i] <= '9') || json[i] == '-')
+            {
+                return number(json, i, out, state);
+            }
+            return fail(state, ParseErrc::UnexpectedChar, json.data() + i);
+        }
+    }
+
+    size_t list(std::string_view json, size_t begin, value_type &out, ParseState &state)
+    {
+        if (++state.depth > opts.max_depth)
+        {
+            return fail(state, ParseErrc::DepthLimit, json.data() + begin);
+        }
+        list_type &res = out.inner.template emplace<list_type>();
+        size_t i = skip(json, begin + 1);
+        if (i < json.size() && json[i] == ']')
+        {
+            state.depth--;
+            return i + 1;
+        }
+        for (;;)
+        {
+            // 先解析再检查个数，出错位置和 parse 一致
+            size_t elem_begin = i;
+            i = value(json, i, res.emplace_back(), state);
+            if (i == 0)
+            {
+                return 0;
+            }
+            if (res.size() > opts.max_elements)
+            {
+                return fail(state, ParseErrc::ElementLimit, json.data() + elem_begin);
+            }
+            i = skip(json, i);
+            if (i == json.size())
+            {
+                return fail(state, ParseErrc::UnexpectedEnd, json.data() + i);
+            }
+            if (json[i] == ']')
+            {
+                i += 1;
+                break;
+            }
+            if (json[i] != ',')
+            {
+                return fail(state, ParseErrc::ExpectedCommaOrBracket, json.data() + i);
+            }
+            i += 1;
+            if constexpr (syntax::trailing_commas)
+            {
+                i = skip(json, i);
+                if (i < json.size() && json[i] == ']')
+                {
+                    i += 1;
+                    break;
+                }
+            }
+        }
+        state.depth--;
+        return i;
+    }
+
+    size_t dict(std::string_view json, size_t begin, value_type &out, ParseState &state)
+    {
+        if (++state.depth > opts.max_depth)
+        {
+            return fail(state, ParseErrc::DepthLimit, json.data() + begin);
+        }
+        dict_type &res = out.inner.template emplace<dict_type>();
+        size_t i = skip(json, begin + 1);
+        if (i < json.size() && json[i] == '}')
+        {
+            state.depth--;
+            return i + 1;
+        }
+        for (size_t count = 0;; count++)
+        {
+            if (i == json.size())
+            {
+                return fail(state, ParseErrc::UnexpectedEnd, json.data() + i);
+            }
+            if (json[i] != '"')
+            {
+                return fail(state, ParseErrc::ExpectedKey, json.data() + i);
+            }
+            size_t key_begin = i;
+            string_type key;
+            i = string(json, i, key, state);
+            if (i == 0)
+            {
+                return 0;
+            }
+            i = skip(json, i);
+            if (i == json.size())
+            {
+                return fail(state, ParseErrc::UnexpectedEnd, json.data() + i);
+            }
+            if (json[i] != ':')
+            {
+                return fail(state, ParseErrc::ExpectedColon, json.data() + i);
+            }
+            if constexpr (std::is_same_v<typename Policy::dict, FlatDict>)
+            {
+                // 平铺的字典直接解析到末尾的新成员里，省一次移动
+                i = value(json, i + 1, res.emplace_back(std::move(key), value_type{}).second, state);
+                if (i == 0)
+                {
+                    return 0;
+                }
+                if (count >= opts.max_elements)
+                {
+                    return fail(state, ParseErrc::ElementLimit, json.data() + key_begin);
+                }
+            }
+            else
+            {
+                value_type val;
+                i = value(json, i + 1, val, state);
+                if (i == 0)
+                {
+                    return 0;
+                }
+                if (count >= opts.max_elements)
+                {
+                    return fail(state, ParseErrc::ElementLimit, json.data() + key_begin);
+                }
+                res.try_emplace(std::move(key), std::move(val));
+            }
+            i = skip(json, i);
+            if (i == json.size())
+            {
+                return fail(state, ParseErrc::UnexpectedEnd, json.data() + i);
+            }
+            if (json[i] == '}')
+            {
+                i += 1;
+                break;
+            }
+            if (json[i] != ',')
+            {
+                return fail(state, ParseErrc::ExpectedCommaOrBrace, json.data() + i);
+            }
+            i = skip(json, i + 1);
+            if constexpr (syntax::trailing_commas)
+            {
+                if (i < json.size() && json[i] == '}')
+                {
+                    i += 1;
+                    break;
+                }
+            }
+        }
+        state.depth--;
+        return i;
+    }
+
+    std::deque<std::string> decoded; // StringViews 下有转义的字符串解码后放这里，地址不随插入变化
+};
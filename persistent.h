@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "json.h"
+
+// 持久化（不可变、结构共享）的 JSON 树：字符串、列表、字典都是引用计数的不可变节点，复制一个值只是增加引用计数
+// 修改不改动原来的树，而是返回新版本：只复制从根到被改节点这条路径上的节点（每个节点浅复制，子节点照旧共享），其余部分新旧版本共用
+// 节点建好后不再修改，各个版本可以在多个线程间随意共享
+//
+//     PersistentJSON v1(parse(text).first);
+//     PersistentJSON v2 = *v1.set_pointer("/server/port", PersistentJSON(JSONObject{8080}));
+//     // v1 不变；v2 和 v1 只有 根、"server" 两个节点不同
+
+class PersistentJSON
+{
+public:
+    using List = std::vector<PersistentJSON>;
+    using Dict = std::unordered_map<std::string, PersistentJSON>;
+
+    PersistentJSON() = default;
+
+    // 从 JSONObject 建树，字符串、列表、字典从 obj 里移走
+    explicit PersistentJSON(JSONObject obj)
+    {
+        std::visit(
+            overloaded{
+                [&](std::string &val)
+                {
+                    inner = std::make_shared<std::string const>(std::move(val));
+                },
+                [&](JSONList &val)
+                {
+                    List list;
+                    list.reserve(val.size());
+                    for (auto &v : val)
+                    {
+                        list.emplace_back(std::move(v));
+                    }
+                    inner = std::make_shared<List const>(std::move(list));
+                },
+                [&](JSONDict &val)
+                {
+                    Dict dict;
+                    dict.reserve(val.size());
+                    while (!val.empty())
+                    {
+                        auto node = val.extract(val.begin());
+                        dict.try_emplace(std::move(node.key()), std::move(node.mapped()));
+                    }
+                    inner = std::make_shared<Dict const>(std::move(dict));
+                },
+                [&](auto scalar)
+                {
+                    inner = scalar;
+                },
+            },
+            obj.inner);
+    }
+
+    explicit PersistentJSON(List list) : inner(std::make_shared<List const>(std::move(list)))
+    {
+    }
+
+    explicit PersistentJSON(Dict dict) : inner(std::make_shared<Dict const>(std::move(dict)))
+    {
+    }
+
+    // 和 JSONObject::inner 的下标一致，和 json_index<T> 比较
+    size_t index() const
+    {
+        return inner.index();
+    }
+
+    // T 用 JSONObject 里的类型，比如 is<JSONDict>()
+    template <class T>
+    bool is() const
+    {
+        return index() == json_index<T>;
+    }
+
+    bool as_bool() const
+    {
+        return std::get<bool>(inner);
+    }
+
+    int as_int() const
+    {
+        return std::get<int>(inner);
+    }
+
+    double as_double() const
+    {
+        return std::get<double>(inner);
+    }
+
+    std::string const &as_string() const
+    {
+        return *std::get<string_ptr>(inner);
+    }
+
+    List const &as_list() const
+    {
+        return *std::get<list_ptr>(inner);
+    }
+
+    Dict const &as_dict() const
+    {
+        return *std::get<dict_ptr>(inner);
+    }
+
+    // 在字典里查找 key，不是字典或找不到时返回 nullptr
+    PersistentJSON const *find(std::string_view key) const
+    {
+        auto dict = std::get_if<dict_ptr>(&inner);
+        if (dict == nullptr)
+        {
+            return nullptr;
+        }
+        auto it = (*dict)->find(std::string(key));
+        return it == (*dict)->end() ? nullptr : &it->second;
+    }
+
+    // 按 JSON Pointer（RFC 6901）查找，空串表示自己；路径不存在时返回 nullptr
+    PersistentJSON const *find_pointer(std::string_view pointer) const
+    {
+        PersistentJSON const *cur = this;
+        while (cur != nullptr && !pointer.empty())
+        {
+            std::string token;
+            if (!next_token(pointer, token))
+            {
+                return nullptr;
+            }
+            if (auto list = std::get_if<list_ptr>(&cur->inner))
+            {
+                size_t i;
+                cur = list_index(token, i) && i < (*list)->size() ? &(**list)[i] : nullptr;
+            }
+            else
+            {
+                cur = cur->find(token);
+            }
+        }
+        return cur;
+    }
+
+    // 以下修改都不改动自己，返回修改后的新版本；类型不对时同 std::get 抛出 std::bad_variant_access
+
+    // 字典里加入或替换 key
+    PersistentJSON set(std::string_view key, PersistentJSON val) const
+    {
+        Dict dict = as_dict();
+        dict.insert_or_assign(std::string(key), std::move(val));
+        return PersistentJSON(std::move(dict));
+    }
+
+    // 字典里删掉 key，没有 key 时返回和自己共享的副本
+    PersistentJSON erase(std::string_view key) const
+    {
+        if (find(key) == nullptr)
+        {
+            return *this;
+        }
+        Dict dict = as_dict();
+        dict.erase(std::string(key));
+        return PersistentJSON(std::move(dict));
+    }
+
+    // 替换列表的第 i 个元素，i 不能越界
+    PersistentJSON set(size_t i, PersistentJSON val) const
+    {
+        List list = as_list();
+        list.at(i) = std::move(val);
+        return PersistentJSON(std::move(list));
+    }
+
+    PersistentJSON push_back(PersistentJSON val) const
+    {
+        List list;
+        list.reserve(as_list().size() + 1);
+        list.insert(list.end(), as_list().begin(), as_list().end());
+        list.push_back(std::move(val));
+        return PersistentJSON(std::move(list));
+    }
+
+    // 把 pointer 处的值换成 val，只复制路径上的节点；最后一段在字典里可以是新键，在列表里可以是 "-" 或等于长度的下标，表示追加
+    // 空串表示换掉整个值；路径不存在或下标不对时返回 nullopt
+    std::optional<PersistentJSON> set_pointer(std::string_view pointer, PersistentJSON val) const
+    {
+        if (pointer.empty())
+        {
+            return val;
+        }
+        std::string token;
+        if (!next_token(pointer, token))
+        {
+            return std::nullopt;
+        }
+        if (auto list = std::get_if<list_ptr>(&inner))
+        {
+            size_t i = (*list)->size();
+            if (token != "-" && (!list_index(token, i) || i > (*list)->size()))
+            {
+                return std::nullopt;
+            }
+            if (i == (*list)->size())
+            {
+                return pointer.empty() ? std::optional<PersistentJSON>(push_back(std::move(val))) : std::nullopt;
+            }
+            auto sub = (**list)[i].set_pointer(pointer, std::move(val));
+            return sub ? std::optional<PersistentJSON>(set(i, std::move(*sub))) : std::nullopt;
+        }
+        if (!is<JSONDict>())
+        {
+            return std::nullopt;
+        }
+        if (pointer.empty())
+        {
+            return set(token, std::move(val));
+        }
+        PersistentJSON const *child = find(token);
+        auto sub = child != nullptr ? child->set_pointer(pointer, std::move(val)) : std::nullopt;
+        return sub ? std::optional<PersistentJSON>(set(token, std::move(*sub))) : std::nullopt;
+    }
+
+    // 两个值是否共用同一个节点（标量按值比较，double 用 ==，0.0 和 -0.0 算相同）；为 true 时按 operator== 必然相等，比较时可以跳过整棵子树
+    bool same_node(PersistentJSON const &other) const
+    {
+        return inner == other.inner;
+    }
+
+    // 按内容比较，共享的子树直接跳过，比较同一棵树的两个版本只看改过的路径
+    bool operator==(PersistentJSON const &other) const
+    {
+        if (same_node(other))
+        {
+            return true;
+        }
+        if (index() != other.index())
+        {
+            return false;
+        }
+        return std::visit(
+            overloaded{
+                [&](string_ptr const &val)
+                {
+                    return *val == other.as_string();
+                },
+                [&](list_ptr const &val)
+                {
+                    return *val == other.as_list();
+                },
+                [&](dict_ptr const &val)
+                {
+                    return *val == other.as_dict();
+                },
+                [&](auto const &)
+                {
+                    // 标量相等时 same_node 已经返回了
+                    return false;
+                },
+            },
+            inner);
+    }
+
+    bool operator!=(PersistentJSON const &other) const
+    {
+        return !(*this == other);
+    }
+
+    // 深复制成普通的 JSONObject
+    JSONObject to_object() const
+    {
+        return std::visit(
+            overloaded{
+                [&](string_ptr const &val)
+                {
+                    return JSONObject{*val};
+                },
+                [&](list_ptr const &val)
+                {
+                    JSONList res;
+                    res.reserve(val->size());
+                    for (auto const &v : *val)
+                    {
+                        res.push_back(v.to_object());
+                    }
+                    return JSONObject{std::move(res)};
+                },
+                [&](dict_ptr const &val)
+                {
+                    JSONDict res;
+                    res.reserve(val->size());
+                    for (auto const &[k, v] : *val)
+                    {
+                        res.try_emplace(k, v.to_object());
+                    }
+                    return JSONObject{std::move(res)};
+                },
+                [&](auto scalar)
+                {
+                    return JSONObject{scalar};
+                },
+            },
+            inner);
+    }
+
+private:
+    using string_ptr = std::shared_ptr<std::string const>;
+    using list_ptr = std::shared_ptr<List const>;
+    using dict_ptr = std::shared_ptr<Dict const>;
+
+    // 取出 pointer 的第一段并解开 ~0、~1，pointer 前进到下一段
+    static bool next_token(std::string_view &pointer, std::string &token)
+    {
+        if (pointer[0] != '/')
+        {
+            return false;
+        }
+        size_t end = std::min(pointer.find('/', 1), pointer.size());
+        token.clear();
+        for (size_t i = 1; i < end; i++)
+        {
+            if (pointer[i] != '~')
+            {
+                token += pointer[i];
+            }
+            else if (i + 1 < end && (pointer[i + 1] == '0' || pointer[i + 1] == '1'))
+            {
+                token += pointer[++i] == '0' ? '~' : '/';
+            }
+            else
+            {
+                return false;
+            }
+        }
+        pointer.remove_prefix(end);
+        return true;
+    }
+
+    // 列表下标：不带前导零的十进制数
+    static bool list_index(std::string const &token, size_t &i)
+    {
+        if (token.empty() || token.size() > 18 || (token[0] == '0' && token.size() > 1))
+        {
+            return false;
+        }
+        i = 0;
+        for (char c : token)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            i = i * 10 + size_t(c - '0');
+        }
+        return true;
+    }
+
+    // 下标和 JSONObject::inner 一致
+    std::variant<std::nullptr_t, bool, int, double, string_ptr, list_ptr, dict_ptr> inner;
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "json.h"
+
+// 读多写少的共享文档：任意多个线程不加锁地读当前版本，后台线程原子地换上新版本
+// 回收用两个纪元轮换：读者进入时在当前纪元对应的计数器上加一，离开时减一；
+// 写者换上新版本后把纪元加一，等上一个纪元的读者都离开，这时旧版本不会再有人读，直接释放
+// 读者从不等待，只做两次原子加减；等待和释放都在发布的线程上
+//
+//     RcuDocument config;
+//     // 后台线程
+//     config.publish(parse(text).first);
+//     // 请求线程
+//     auto doc = config.read();
+//     auto timeout = doc->get<JSONDict>().find("timeout");
+
+template <class T = JSONObject>
+class basic_rcu_document
+{
+    // 读者计数按线程分散到几个缓存行上，不同线程的读者互不争用
+    static constexpr size_t stripes = 16;
+
+    struct alignas(64) Counter
+    {
+        std::atomic<size_t> readers{0};
+    };
+
+public:
+    // 读者持有的引用，存在期间指向的版本不会被释放；只在一个线程里用，不要长期持有，否则发布会一直等
+    class reader
+    {
+    public:
+        reader(reader &&other) noexcept : value(other.value), counter(std::exchange(other.counter, nullptr))
+        {
+        }
+
+        reader(reader const &) = delete;
+        reader &operator=(reader const &) = delete;
+        reader &operator=(reader &&) = delete;
+
+        ~reader()
+        {
+            if (counter != nullptr)
+            {
+                counter->readers.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        T const &operator*() const
+        {
+            return *value;
+        }
+
+        T const *operator->() const
+        {
+            return value;
+        }
+
+    private:
+        friend class basic_rcu_document;
+
+        reader(T const *value, Counter *counter) : value(value), counter(counter)
+        {
+        }
+
+        T const *value;
+        Counter *counter;
+    };
+
+    explicit basic_rcu_document(T initial = T{}) : current(new T(std::move(initial)))
+    {
+    }
+
+    basic_rcu_document(basic_rcu_document const &) = delete;
+    basic_rcu_document &operator=(basic_rcu_document const &) = delete;
+
+    // 销毁时不能还有读者
+    ~basic_rcu_document()
+    {
+        delete current.load();
+    }
+
+    // 取当前版本，不加锁也不等待
+    reader read() const
+    {
+        Counter *counter;
+        for (;;)
+        {
+            uint64_t e = epoch.load();
+            counter = &counters[e & 1][stripe()];
+            counter->readers.fetch_add(1);
+            // 加计数期间纪元变了，写者可能已经开始等这个计数器，换到新纪元重来
+            if (epoch.load() == e)
+            {
+                break;
+            }
+            counter->readers.fetch_sub(1);
+        }
+        return reader(current.load(), counter);
+    }
+
+    // 换上新版本，等读旧版本的读者都离开后释放旧版本再返回；多个写者之间互斥
+    void publish(T value)
+    {
+        std::lock_guard<std::mutex> lock(writer);
+        swap_in(new T(std::move(value)));
+    }
+
+    // 复制当前版本，用 fn 修改后发布；两次 update 之间不会丢失修改
+    template <class F>
+    void update(F &&fn)
+    {
+        std::lock_guard<std::mutex> lock(writer);
+        auto next = std::make_unique<T>(*current.load());
+        std::forward<F>(fn)(*next);
+        swap_in(next.release());
+    }
+
+private:
+    // 同一个线程总是用同一个计数器
+    static size_t stripe()
+    {
+        static thread_local size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) % stripes;
+        return index;
+    }
+
+    void swap_in(T *next)
+    {
+        std::unique_ptr<T> old(current.exchange(next));
+        // 之后进来的读者都在新纪元，只会读到 next；等旧纪元的读者走完
+        uint64_t e = epoch.fetch_add(1);
+        for (auto &counter : counters[e & 1])
+        {
+            while (counter.readers.load() != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    std::atomic<T *> current;
+    std::atomic<uint64_t> epoch{0};
+    mutable std::array<std::array<Counter, stripes>, 2> counters;
+    std::mutex writer;
+};
+
+using RcuDocument = basic_rcu_document<>;
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "json.h"
+
+// 大树的释放：默认的析构沿着 variant、vector、unordered_map 逐层递归，嵌套深时可能爆栈，大文档要花几毫秒
+// destroy 用显式的栈逐层拆开，递归深度和嵌套层数无关；Reclaimer 把整棵树交给后台线程去释放，调用线程只做一次 O(1) 的移动
+//
+//     Reclaimer reclaimer;
+//     ...
+//     reclaimer.reclaim(std::move(response)); // 请求线程不等释放
+
+// 不递归地释放 obj，之后 obj 为 null
+template <class Allocator>
+void destroy(basic_json<Allocator> &&obj)
+{
+    using Json = basic_json<Allocator>;
+    std::vector<Json> stack;
+    stack.push_back(std::move(obj));
+    obj = Json{std::nullptr_t{}};
+    auto is_container = [](Json const &val)
+    {
+        return val.inner.index() >= json_index<JSONList>;
+    };
+    // 子节点里还有列表、字典的才移到栈上，剩下的容器析构时最多再深一层，大量的小数组也不用搬来搬去
+    auto defer = [&](Json &child)
+    {
+        bool nested = false;
+        if (auto list = std::get_if<typename Json::list_type>(&child.inner))
+        {
+            nested = std::any_of(list->begin(), list->end(), is_container);
+        }
+        else if (auto dict = std::get_if<typename Json::dict_type>(&child.inner))
+        {
+            nested = std::any_of(dict->begin(), dict->end(), [&](auto const &entry)
+                                 { return is_container(entry.second); });
+        }
+        if (nested)
+        {
+            stack.push_back(std::move(child));
+        }
+    };
+    while (!stack.empty())
+    {
+        Json cur = std::move(stack.back());
+        stack.pop_back();
+        if (auto list = std::get_if<typename Json::list_type>(&cur.inner))
+        {
+            for (auto &child : *list)
+            {
+                defer(child);
+            }
+        }
+        else if (auto dict = std::get_if<typename Json::dict_type>(&cur.inner))
+        {
+            for (auto &entry : *dict)
+            {
+                defer(entry.second);
+            }
+        }
+    }
+}
+
+// 后台释放线程，析构时释放完队列里剩下的树再退出
+class Reclaimer
+{
+public:
+    Reclaimer() : worker([this]
+                         { run(); })
+    {
+    }
+
+    Reclaimer(Reclaimer const &) = delete;
+    Reclaimer &operator=(Reclaimer const &) = delete;
+
+    ~Reclaimer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    // 接管 obj，之后 obj 为 null；调用线程上只有一次移动和一次加锁入队
+    void reclaim(JSONObject &&obj)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(obj));
+        }
+        obj = JSONObject{std::nullptr_t{}};
+        wake.notify_one();
+    }
+
+    // 等队列里已有的树都释放完，测试和统计内存时用
+    void drain()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [&]
+                  { return queue.empty() && !busy; });
+    }
+
+private:
+    void run()
+    {
+        std::vector<JSONObject> batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            wake.wait(lock, [&]
+                      { return stopping || !queue.empty(); });
+            if (queue.empty())
+            {
+                return;
+            }
+            // 整批取走，释放期间不占着锁
+            batch.swap(queue);
+            busy = true;
+            lock.unlock();
+            for (auto &obj : batch)
+            {
+                destroy(std::move(obj));
+            }
+            batch.clear();
+            lock.lock();
+            busy = false;
+            idle.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::vector<JSONObject> queue;
+    bool busy = false;
+    bool stopping = false;
+    std::thread worker; // 最后构造，启动时其余成员都已就绪
+};
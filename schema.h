@@ -0,0 +1,1230 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "json.h"
+
+// JSON Schema（draft 2020-12 的常用子集）编译成扁平的节点表，节点之间用下标引用
+// 编译好的 Schema 既能校验建好的 JSONObject，也能跟着 scan() 的词法单元边扫边校验，不建树
+
+// 校验结果：keyword 为没通过的关键字，path 为出错的值的 JSON Pointer
+// 输入本身不是合法 JSON 时 keyword 为 "json"，原因见 parse
+struct SchemaError
+{
+    char const *keyword = nullptr;
+    std::string path;
+    ParseError parse;
+
+    bool ok() const
+    {
+        return keyword == nullptr;
+    }
+
+    void do_print() const
+    {
+        if (keyword == nullptr)
+        {
+            std::cout << "ok";
+        }
+        else if (parse.code != ParseErrc::Ok)
+        {
+            parse.do_print();
+        }
+        else
+        {
+            std::cout << keyword << " failed at '" << path << "'";
+        }
+    }
+};
+
+namespace _schema_details {
+    constexpr uint32_t none = UINT32_MAX;
+
+    enum TypeBits : uint8_t
+    {
+        type_null = 1 << 0,
+        type_boolean = 1 << 1,
+        type_integer = 1 << 2,
+        type_number = 1 << 3, // 不是整数的数
+        type_string = 1 << 4,
+        type_array = 1 << 5,
+        type_object = 1 << 6,
+        type_any = 0x7F,
+    };
+
+    struct Property
+    {
+        uint32_t schema = none;   // properties 里的子 schema，none 表示只出现在 required 里
+        uint32_t required = none; // 在 required 里的序号
+    };
+
+    struct SchemaNode
+    {
+        bool never = false;      // false schema，什么都不接受
+        bool needs_tree = false; // 容器值要拿到整棵子树才能判断：enum、const、uniqueItems、anyOf、oneOf、not
+        uint8_t types = type_any;
+        double minimum = -HUGE_VAL;
+        double maximum = HUGE_VAL;
+        bool exclusive_minimum = false;
+        bool exclusive_maximum = false;
+        double multiple_of = 0;
+        size_t min_length = 0; // 按码点计
+        size_t max_length = SIZE_MAX;
+        size_t min_items = 0;
+        size_t max_items = SIZE_MAX;
+        bool unique_items = false;
+        std::vector<uint32_t> prefix_items;
+        uint32_t items = none; // prefix_items 之后的元素
+        size_t min_properties = 0;
+        size_t max_properties = SIZE_MAX;
+        std::unordered_map<std::string, Property> properties;
+        size_t num_required = 0;
+        uint32_t additional_properties = none;
+        std::vector<uint32_t> all_of;
+        std::vector<uint32_t> any_of;
+        std::vector<uint32_t> one_of;
+        uint32_t not_schema = none;
+        bool has_enum = false;
+        JSONList enum_values;
+    };
+
+    inline uint8_t type_of(JSONObject const &v)
+    {
+        switch (v.inner.index())
+        {
+        case 0:
+            return type_null;
+        case 1:
+            return type_boolean;
+        case 2:
+            return type_integer;
+        case 3:
+        {
+            double d = v.get<double>();
+            return std::floor(d) == d ? type_integer : type_number;
+        }
+        case 4:
+            return type_string;
+        case 5:
+            return type_array;
+        default:
+            return type_object;
+        }
+    }
+
+    inline std::optional<double> as_number(JSONObject const &v)
+    {
+        if (v.is<int>())
+        {
+            return v.get<int>();
+        }
+        if (v.is<double>())
+        {
+            return v.get<double>();
+        }
+        return std::nullopt;
+    }
+
+    // JSON Schema 意义下的相等：1 和 1.0 相等，字典不看顺序
+    inline bool json_equal(JSONObject const &a, JSONObject const &b)
+    {
+        if (auto x = as_number(a))
+        {
+            auto y = as_number(b);
+            return y && *x == *y;
+        }
+        if (auto *la = std::get_if<JSONList>(&a.inner))
+        {
+            auto *lb = std::get_if<JSONList>(&b.inner);
+            if (lb == nullptr || la->size() != lb->size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < la->size(); i++)
+            {
+                if (!json_equal((*la)[i], (*lb)[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (auto *da = std::get_if<JSONDict>(&a.inner))
+        {
+            auto *db = std::get_if<JSONDict>(&b.inner);
+            if (db == nullptr || da->size() != db->size())
+            {
+                return false;
+            }
+            for (auto const &[k, v] : *da)
+            {
+                auto it = db->find(k);
+                if (it == db->end() || !json_equal(v, it->second))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return a == b;
+    }
+
+    inline size_t count_code_points(std::string_view str)
+    {
+        size_t n = 0;
+        for (char ch : str)
+        {
+            n += (static_cast<unsigned char>(ch) & 0xC0) != 0x80;
+        }
+        return n;
+    }
+
+    // 把已经校验过的字符串原文（含引号）解码到 out
+    inline void decode_string(std::string_view raw, std::string &out)
+    {
+        out.clear();
+        if (raw.find('\\') == raw.npos)
+        {
+            out.append(raw.data() + 1, raw.size() - 2);
+            return;
+        }
+        ParseOptions opts;
+        opts.validate_utf8 = false;
+        ParseState state;
+        parse_string(raw, out, opts, state);
+    }
+
+    // JSON Pointer 里 '~' 写成 "~0"，'/' 写成 "~1"
+    inline void append_pointer_segment(std::string &path, std::string_view segment)
+    {
+        path += '/';
+        for (char ch : segment)
+        {
+            if (ch == '~')
+            {
+                path += "~0";
+            }
+            else if (ch == '/')
+            {
+                path += "~1";
+            }
+            else
+            {
+                path += ch;
+            }
+        }
+    }
+
+    class _compiler
+    {
+    public:
+        std::vector<SchemaNode> nodes;
+        std::string error;
+
+        // 返回节点下标，出错返回 none，原因见 error
+        uint32_t compile(JSONObject const &schema)
+        {
+            uint32_t idx = uint32_t(nodes.size());
+            nodes.emplace_back();
+            if (schema.is<bool>())
+            {
+                nodes[idx].never = !schema.get<bool>();
+                return idx;
+            }
+            if (!schema.is<JSONDict>())
+            {
+                return fail("schema must be an object or a boolean");
+            }
+            JSONDict const &dict = schema.get<JSONDict>();
+            static char const *const unsupported[] = {
+                "$ref", "$dynamicRef", "$recursiveRef", "pattern", "patternProperties", "propertyNames",
+                "contains", "minContains", "maxContains", "if", "then", "else", "dependentRequired",
+                "dependentSchemas", "dependencies", "unevaluatedItems", "unevaluatedProperties"};
+            for (auto const &[key, val] : dict)
+            {
+                for (char const *name : unsupported)
+                {
+                    if (key == name)
+                    {
+                        return fail("unsupported keyword: " + key);
+                    }
+                }
+            }
+            auto get = [&](char const *key) -> JSONObject const *
+            {
+                auto it = dict.find(key);
+                return it == dict.end() ? nullptr : &it->second;
+            };
+
+            if (auto *v = get("type"))
+            {
+                uint8_t types = 0;
+                if (v->is<std::string>())
+                {
+                    types = type_bits(v->get<std::string>());
+                }
+                else if (v->is<JSONList>())
+                {
+                    for (auto const &t : v->get<JSONList>())
+                    {
+                        types |= t.is<std::string>() ? type_bits(t.get<std::string>()) : 0;
+                    }
+                }
+                if (types == 0)
+                {
+                    return fail("invalid type");
+                }
+                nodes[idx].types = types;
+            }
+            if (auto *v = get("enum"))
+            {
+                if (!v->is<JSONList>())
+                {
+                    return fail("enum must be an array");
+                }
+                nodes[idx].has_enum = true;
+                nodes[idx].enum_values = v->get<JSONList>();
+            }
+            if (auto *v = get("const"))
+            {
+                nodes[idx].has_enum = true;
+                nodes[idx].enum_values = JSONList{*v};
+            }
+
+            // 数
+            if (!number(get("minimum"), nodes[idx].minimum) || !number(get("maximum"), nodes[idx].maximum))
+            {
+                return fail("minimum and maximum must be numbers");
+            }
+            if (auto *v = get("multipleOf"))
+            {
+                // 规范要求严格大于 0；检查里 0 表示没有这个关键字
+                if (!number(v, nodes[idx].multiple_of) || !(nodes[idx].multiple_of > 0))
+                {
+                    return fail("multipleOf must be a number greater than 0");
+                }
+            }
+            if (!exclusive(get("exclusiveMinimum"), true, nodes[idx].minimum, nodes[idx].exclusive_minimum) ||
+                !exclusive(get("exclusiveMaximum"), false, nodes[idx].maximum, nodes[idx].exclusive_maximum))
+            {
+                return fail("exclusiveMinimum and exclusiveMaximum must be numbers or booleans");
+            }
+
+            // 字符串
+            if (!count(get("minLength"), nodes[idx].min_length) || !count(get("maxLength"), nodes[idx].max_length))
+            {
+                return fail("minLength and maxLength must be non-negative integers");
+            }
+
+            // 列表
+            if (!count(get("minItems"), nodes[idx].min_items) || !count(get("maxItems"), nodes[idx].max_items))
+            {
+                return fail("minItems and maxItems must be non-negative integers");
+            }
+            if (auto *v = get("uniqueItems"))
+            {
+                nodes[idx].unique_items = v->is<bool>() && v->get<bool>();
+            }
+            // 老版本的 items 数组就是 prefixItems，之后的元素由 additionalItems 约束
+            JSONObject const *prefix = get("prefixItems");
+            JSONObject const *items = get("items");
+            if (items != nullptr && items->is<JSONList>())
+            {
+                prefix = items;
+                items = get("additionalItems");
+            }
+            if (prefix != nullptr && !prefix->is<JSONList>())
+            {
+                return fail("prefixItems must be an array");
+            }
+            std::vector<uint32_t> prefix_items;
+            if (prefix != nullptr)
+            {
+                for (auto const &sub : prefix->get<JSONList>())
+                {
+                    uint32_t c = compile(sub);
+                    if (c == none)
+                    {
+                        return none;
+                    }
+                    prefix_items.push_back(c);
+                }
+            }
+            nodes[idx].prefix_items = std::move(prefix_items);
+            uint32_t items_schema = none;
+            if (!child(items, items_schema))
+            {
+                return none;
+            }
+            nodes[idx].items = items_schema;
+
+            // 字典
+            if (!count(get("minProperties"), nodes[idx].min_properties) ||
+                !count(get("maxProperties"), nodes[idx].max_properties))
+            {
+                return fail("minProperties and maxProperties must be non-negative integers");
+            }
+            if (auto *v = get("properties"))
+            {
+                if (!v->is<JSONDict>())
+                {
+                    return fail("properties must be an object");
+                }
+                for (auto const &[name, sub] : v->get<JSONDict>())
+                {
+                    uint32_t c = compile(sub);
+                    if (c == none)
+                    {
+                        return none;
+                    }
+                    nodes[idx].properties[name].schema = c;
+                }
+            }
+            if (auto *v = get("required"))
+            {
+                if (!v->is<JSONList>())
+                {
+                    return fail("required must be an array");
+                }
+                for (auto const &name : v->get<JSONList>())
+                {
+                    if (!name.is<std::string>())
+                    {
+                        return fail("required must contain strings");
+                    }
+                    Property &prop = nodes[idx].properties[name.get<std::string>()];
+                    if (prop.required == none)
+                    {
+                        prop.required = uint32_t(nodes[idx].num_required++);
+                    }
+                }
+            }
+            uint32_t additional = none;
+            if (!child(get("additionalProperties"), additional))
+            {
+                return none;
+            }
+
+            // 组合
+            std::vector<uint32_t> all_of, any_of, one_of;
+            uint32_t not_schema = none;
+            if (!children(get("allOf"), all_of) || !children(get("anyOf"), any_of) ||
+                !children(get("oneOf"), one_of) || !child(get("not"), not_schema))
+            {
+                return none;
+            }
+
+            SchemaNode &node = nodes[idx];
+            node.additional_properties = additional;
+            node.all_of = std::move(all_of);
+            node.any_of = std::move(any_of);
+            node.one_of = std::move(one_of);
+            node.not_schema = not_schema;
+            node.needs_tree = node.has_enum || node.unique_items || !node.any_of.empty() || !node.one_of.empty() ||
+                              node.not_schema != none;
+            return idx;
+        }
+
+    private:
+        uint32_t fail(std::string why)
+        {
+            if (error.empty())
+            {
+                error = std::move(why);
+            }
+            return none;
+        }
+
+        static uint8_t type_bits(std::string const &name)
+        {
+            if (name == "null")
+                return type_null;
+            if (name == "boolean")
+                return type_boolean;
+            if (name == "integer")
+                return type_integer;
+            if (name == "number")
+                return type_integer | type_number;
+            if (name == "string")
+                return type_string;
+            if (name == "array")
+                return type_array;
+            if (name == "object")
+                return type_object;
+            return 0;
+        }
+
+        static bool number(JSONObject const *v, double &out)
+        {
+            if (v == nullptr)
+            {
+                return true;
+            }
+            auto num = as_number(*v);
+            if (num)
+            {
+                out = *num;
+            }
+            return num.has_value();
+        }
+
+        // 新版本的 exclusiveMinimum 是单独的界，draft 4 里是修饰 minimum 的 bool；和 minimum 同时给出时取更严的
+        static bool exclusive(JSONObject const *v, bool is_min, double &bound, bool &flag)
+        {
+            if (v == nullptr)
+            {
+                return true;
+            }
+            if (v->is<bool>())
+            {
+                flag = v->get<bool>();
+                return true;
+            }
+            auto num = as_number(*v);
+            if (!num)
+            {
+                return false;
+            }
+            if (is_min ? *num >= bound : *num <= bound)
+            {
+                bound = *num;
+                flag = true;
+            }
+            return true;
+        }
+
+        static bool count(JSONObject const *v, size_t &out)
+        {
+            if (v == nullptr)
+            {
+                return true;
+            }
+            auto num = as_number(*v);
+            if (!num || *num < 0 || std::floor(*num) != *num)
+            {
+                return false;
+            }
+            out = *num >= 1.8e19 ? SIZE_MAX : size_t(*num);
+            return true;
+        }
+
+        // compile 会往 nodes 里追加节点，out 不能是 nodes 里某个节点的成员
+        bool child(JSONObject const *v, uint32_t &out)
+        {
+            if (v == nullptr)
+            {
+                return true;
+            }
+            out = compile(*v);
+            return out != none;
+        }
+
+        bool children(JSONObject const *v, std::vector<uint32_t> &out)
+        {
+            if (v == nullptr)
+            {
+                return true;
+            }
+            if (!v->is<JSONList>() || v->get<JSONList>().empty())
+            {
+                fail("allOf, anyOf and oneOf must be non-empty arrays");
+                return false;
+            }
+            for (auto const &sub : v->get<JSONList>())
+            {
+                uint32_t c = compile(sub);
+                if (c == none)
+                {
+                    return false;
+                }
+                out.push_back(c);
+            }
+            return true;
+        }
+    };
+
+    // 在建好的树上校验
+    class _tree_validator
+    {
+    public:
+        std::vector<SchemaNode> const &nodes;
+        std::string path;
+        SchemaError error;
+
+        explicit _tree_validator(std::vector<SchemaNode> const &nodes_) : nodes(nodes_)
+        {
+        }
+
+        bool check(uint32_t idx, JSONObject const &v)
+        {
+            if (idx == none)
+            {
+                return true;
+            }
+            SchemaNode const &node = nodes[idx];
+            if (node.never)
+            {
+                return fail("false");
+            }
+            if ((type_of(v) & node.types) == 0)
+            {
+                return fail("type");
+            }
+            if (node.has_enum && !in_enum(node, v))
+            {
+                return fail("enum");
+            }
+            if (auto num = as_number(v))
+            {
+                if (!check_number(node, *num))
+                {
+                    return false;
+                }
+            }
+            else if (auto *str = std::get_if<std::string>(&v.inner))
+            {
+                size_t len = count_code_points(*str);
+                if (len < node.min_length || len > node.max_length)
+                {
+                    return fail(len < node.min_length ? "minLength" : "maxLength");
+                }
+            }
+            else if (auto *list = std::get_if<JSONList>(&v.inner))
+            {
+                if (!check_list(node, *list))
+                {
+                    return false;
+                }
+            }
+            else if (auto *dict = std::get_if<JSONDict>(&v.inner))
+            {
+                if (!check_dict(node, *dict))
+                {
+                    return false;
+                }
+            }
+            return check_combinators(node, v);
+        }
+
+        // 数值关键字在流式校验里也要用，单独拿出来
+        bool check_number(SchemaNode const &node, double x)
+        {
+            if (node.exclusive_minimum ? !(x > node.minimum) : !(x >= node.minimum))
+            {
+                return fail(node.exclusive_minimum ? "exclusiveMinimum" : "minimum");
+            }
+            if (node.exclusive_maximum ? !(x < node.maximum) : !(x <= node.maximum))
+            {
+                return fail(node.exclusive_maximum ? "exclusiveMaximum" : "maximum");
+            }
+            if (node.multiple_of > 0 && !multiple_of(x, node.multiple_of))
+            {
+                return fail("multipleOf");
+            }
+            return true;
+        }
+
+        // m > 0；两边都是 double 能精确表示的整数时按整数取余，否则商离最近的整数不超过几个 ulp 才算整除（0.3 是 0.1 的倍数）
+        static bool multiple_of(double x, double m)
+        {
+            constexpr double exact = 9007199254740992.0; // 2^53
+            if (std::trunc(x) == x && std::trunc(m) == m && std::abs(x) <= exact && m <= exact)
+            {
+                return int64_t(x) % int64_t(m) == 0;
+            }
+            double q = x / m;
+            if (!std::isfinite(q))
+            {
+                return false;
+            }
+            double r = std::round(q);
+            if (r == 0)
+            {
+                // 商下溢成 0 时 x 也不是倍数
+                return x == 0;
+            }
+            double ulp = std::nextafter(std::abs(r), HUGE_VAL) - std::abs(r);
+            return std::abs(q - r) <= 4 * ulp;
+        }
+
+        bool check_combinators(SchemaNode const &node, JSONObject const &v)
+        {
+            for (uint32_t sub : node.all_of)
+            {
+                if (!check(sub, v))
+                {
+                    return false;
+                }
+            }
+            if (!node.any_of.empty())
+            {
+                bool any = false;
+                quiet++;
+                for (size_t i = 0; i < node.any_of.size() && !any; i++)
+                {
+                    any = check(node.any_of[i], v);
+                }
+                quiet--;
+                if (!any)
+                {
+                    return fail("anyOf");
+                }
+            }
+            if (!node.one_of.empty())
+            {
+                size_t passed = 0;
+                quiet++;
+                for (size_t i = 0; i < node.one_of.size() && passed < 2; i++)
+                {
+                    passed += check(node.one_of[i], v);
+                }
+                quiet--;
+                if (passed != 1)
+                {
+                    return fail("oneOf");
+                }
+            }
+            if (node.not_schema != none)
+            {
+                quiet++;
+                bool passed = check(node.not_schema, v);
+                quiet--;
+                if (passed)
+                {
+                    return fail("not");
+                }
+            }
+            return true;
+        }
+
+        bool fail(char const *keyword)
+        {
+            // anyOf、oneOf、not 的分支里失败是正常的，不记录
+            if (quiet == 0 && error.keyword == nullptr)
+            {
+                error.keyword = keyword;
+                error.path = path;
+            }
+            return false;
+        }
+
+    private:
+        size_t quiet = 0;
+
+        static bool in_enum(SchemaNode const &node, JSONObject const &v)
+        {
+            for (auto const &e : node.enum_values)
+            {
+                if (json_equal(e, v))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool check_list(SchemaNode const &node, JSONList const &list)
+        {
+            if (list.size() < node.min_items || list.size() > node.max_items)
+            {
+                return fail(list.size() < node.min_items ? "minItems" : "maxItems");
+            }
+            if (node.unique_items)
+            {
+                for (size_t i = 0; i < list.size(); i++)
+                {
+                    for (size_t j = i + 1; j < list.size(); j++)
+                    {
+                        if (json_equal(list[i], list[j]))
+                        {
+                            return fail("uniqueItems");
+                        }
+                    }
+                }
+            }
+            for (size_t i = 0; i < list.size(); i++)
+            {
+                uint32_t sub = i < node.prefix_items.size() ? node.prefix_items[i] : node.items;
+                if (sub == none)
+                {
+                    continue;
+                }
+                size_t old_size = path.size();
+                append_pointer_segment(path, std::to_string(i));
+                bool ok = check(sub, list[i]);
+                path.resize(old_size);
+                if (!ok)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool check_dict(SchemaNode const &node, JSONDict const &dict)
+        {
+            if (dict.size() < node.min_properties || dict.size() > node.max_properties)
+            {
+                return fail(dict.size() < node.min_properties ? "minProperties" : "maxProperties");
+            }
+            if (node.num_required != 0)
+            {
+                for (auto const &[name, prop] : node.properties)
+                {
+                    if (prop.required != none && dict.find(name) == dict.end())
+                    {
+                        return fail("required");
+                    }
+                }
+            }
+            for (auto const &[key, val] : dict)
+            {
+                auto it = node.properties.find(key);
+                uint32_t sub = it != node.properties.end() && it->second.schema != none ? it->second.schema : node.additional_properties;
+                if (sub == none)
+                {
+                    continue;
+                }
+                size_t old_size = path.size();
+                append_pointer_segment(path, key);
+                bool ok = check(sub, val);
+                path.resize(old_size);
+                if (!ok)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    // 由 scan() 的词法单元还原出一棵树，流式校验遇到需要整棵子树的 schema 时用
+    struct _tree_builder
+    {
+        std::vector<JSONObject> stack; // 还没结束的容器
+        std::vector<std::string> keys; // 字典里等着值的键
+        JSONObject result;
+
+        void value(JSONObject &&v)
+        {
+            if (stack.empty())
+            {
+                result = std::move(v);
+            }
+            else if (auto *list = std::get_if<JSONList>(&stack.back().inner))
+            {
+                list->push_back(std::move(v));
+            }
+            else
+            {
+                // 重复的键保留第一个，和 parse 一致
+                stack.back().get<JSONDict>().try_emplace(std::move(keys.back()), std::move(v));
+                keys.pop_back();
+            }
+        }
+
+        void begin(JSONObject &&container)
+        {
+            stack.push_back(std::move(container));
+        }
+
+        void end()
+        {
+            JSONObject v = std::move(stack.back());
+            stack.pop_back();
+            value(std::move(v));
+        }
+    };
+
+    // 跟着 scan() 的词法单元边扫边校验
+    // 每个值要满足的 schema 是一个集合（allOf 直接展开进去），容器的集合压在栈上
+    class _stream_validator : public NullHandler
+    {
+    public:
+        SchemaError error;
+
+        explicit _stream_validator(std::vector<SchemaNode> const &nodes_) : nodes(nodes_), tree(nodes_)
+        {
+            add(0);
+        }
+
+        void scalar(std::string_view raw)
+        {
+            if (capturing(raw, false))
+            {
+                return;
+            }
+            JSONObject v;
+            if (raw[0] == 't' || raw[0] == 'f')
+            {
+                v.inner = raw[0] == 't';
+            }
+            else if (raw[0] != 'n')
+            {
+                ParseState state;
+                v = parse_number(raw, state).first;
+            }
+            check_scalar(v);
+        }
+
+        void string(std::string_view raw)
+        {
+            if (capturing(raw, true))
+            {
+                return;
+            }
+            decode_string(raw, str.get<std::string>());
+            check_scalar(str);
+        }
+
+        void key(std::string_view raw, size_t)
+        {
+            if (capture_depth != 0)
+            {
+                builder.keys.emplace_back();
+                decode_string(raw, builder.keys.back());
+                return;
+            }
+            if (error.keyword != nullptr)
+            {
+                return;
+            }
+            Frame &frame = frames.back();
+            frame.key = raw;
+            decode_string(raw, key_buf);
+            size_t seen_at = frame.seen_begin;
+            for (size_t i = frame.schemas_begin; i < frame.schemas_end; i++)
+            {
+                SchemaNode const &node = nodes[active[i]];
+                auto it = node.properties.find(key_buf);
+                if (it != node.properties.end() && it->second.required != none)
+                {
+                    seen[seen_at + it->second.required] = 1;
+                }
+                add(it != node.properties.end() && it->second.schema != none ? it->second.schema : node.additional_properties);
+                seen_at += node.num_required;
+            }
+        }
+
+        void element(size_t index)
+        {
+            if (capture_depth != 0 || error.keyword != nullptr)
+            {
+                return;
+            }
+            Frame &frame = frames.back();
+            frame.index = index;
+            for (size_t i = frame.schemas_begin; i < frame.schemas_end; i++)
+            {
+                SchemaNode const &node = nodes[active[i]];
+                add(index < node.prefix_items.size() ? node.prefix_items[index] : node.items);
+            }
+        }
+
+        void begin_list()
+        {
+            begin(true);
+        }
+
+        void begin_dict()
+        {
+            begin(false);
+        }
+
+        void end_list(size_t count)
+        {
+            end(count);
+        }
+
+        void end_dict(size_t count)
+        {
+            end(count);
+        }
+
+    private:
+        struct Frame
+        {
+            size_t schemas_begin; // 这个容器的 schema 集合是 active[schemas_begin, schemas_end)
+            size_t schemas_end;
+            size_t seen_begin;    // required 里的键是否出现过，seen[seen_begin, ...)，按集合顺序排
+            bool is_list;
+            size_t index = 0;     // 正在校验的元素下标或成员的键，出错时拼路径用
+            std::string_view key{};
+        };
+
+        std::vector<SchemaNode> const &nodes;
+        _tree_validator tree;
+        std::vector<uint32_t> pending; // 下一个值要满足的 schema
+        std::vector<uint32_t> active;
+        std::vector<char> seen;
+        std::vector<Frame> frames;
+        JSONObject str{std::string()};
+        std::string key_buf;
+        // 正在为 capture_schemas 还原子树
+        size_t capture_depth = 0;
+        std::vector<uint32_t> capture_schemas;
+        _tree_builder builder;
+
+        void add(uint32_t idx)
+        {
+            if (idx == none)
+            {
+                return;
+            }
+            pending.push_back(idx);
+            for (uint32_t sub : nodes[idx].all_of)
+            {
+                add(sub);
+            }
+        }
+
+        // 当前值的 JSON Pointer，levels 为计入的容器层数
+        std::string current_path(size_t levels)
+        {
+            std::string path;
+            for (size_t i = 0; i < levels; i++)
+            {
+                if (frames[i].is_list)
+                {
+                    append_pointer_segment(path, std::to_string(frames[i].index));
+                }
+                else
+                {
+                    decode_string(frames[i].key, key_buf);
+                    append_pointer_segment(path, key_buf);
+                }
+            }
+            return path;
+        }
+
+        void fail(char const *keyword, size_t levels)
+        {
+            error.keyword = keyword;
+            error.path = current_path(levels);
+        }
+
+        // 用树校验器检查 v，出错时把流里的路径接在前面
+        void check_tree(std::vector<uint32_t> const &schemas, JSONObject const &v)
+        {
+            for (uint32_t idx : schemas)
+            {
+                if (!tree.check(idx, v))
+                {
+                    error.keyword = tree.error.keyword;
+                    error.path = current_path(frames.size()) + tree.error.path;
+                    return;
+                }
+            }
+        }
+
+        void check_scalar(JSONObject const &v)
+        {
+            if (error.keyword == nullptr)
+            {
+                check_tree(pending, v);
+            }
+            pending.clear();
+        }
+
+        // 还原子树时标量直接交给 builder，返回 true 表示已经处理
+        bool capturing(std::string_view raw, bool is_string)
+        {
+            if (capture_depth == 0)
+            {
+                return error.keyword != nullptr;
+            }
+            if (is_string)
+            {
+                JSONObject v{std::string()};
+                decode_string(raw, v.get<std::string>());
+                builder.value(std::move(v));
+            }
+            else
+            {
+                ParseState state;
+                builder.value(raw[0] == 't' ? JSONObject{true} : raw[0] == 'f' ? JSONObject{false} : raw[0] == 'n' ? JSONObject{std::nullptr_t{}} : parse_number(raw, state).first);
+            }
+            return true;
+        }
+
+        void begin(bool is_list)
+        {
+            if (capture_depth != 0)
+            {
+                capture_depth++;
+                builder.begin(is_list ? JSONObject{JSONList{}} : JSONObject{JSONDict{}});
+                return;
+            }
+            if (error.keyword != nullptr)
+            {
+                return;
+            }
+            bool needs_tree = false;
+            for (uint32_t idx : pending)
+            {
+                SchemaNode const &node = nodes[idx];
+                if (node.never)
+                {
+                    return fail("false", frames.size());
+                }
+                if ((node.types & (is_list ? type_array : type_object)) == 0)
+                {
+                    return fail("type", frames.size());
+                }
+                needs_tree = needs_tree || node.needs_tree;
+            }
+            if (needs_tree)
+            {
+                capture_schemas.swap(pending);
+                pending.clear();
+                capture_depth = 1;
+                builder.begin(is_list ? JSONObject{JSONList{}} : JSONObject{JSONDict{}});
+                return;
+            }
+            Frame frame{active.size(), active.size() + pending.size(), seen.size(), is_list};
+            for (uint32_t idx : pending)
+            {
+                active.push_back(idx);
+                seen.resize(seen.size() + nodes[idx].num_required);
+            }
+            pending.clear();
+            frames.push_back(frame);
+        }
+
+        void end(size_t count)
+        {
+            if (capture_depth != 0)
+            {
+                builder.end();
+                if (--capture_depth == 0)
+                {
+                    check_tree(capture_schemas, builder.result);
+                    builder.result = JSONObject{};
+                }
+                return;
+            }
+            if (error.keyword != nullptr)
+            {
+                return;
+            }
+            Frame &frame = frames.back();
+            size_t seen_at = frame.seen_begin;
+            for (size_t i = frame.schemas_begin; i < frame.schemas_end; i++)
+            {
+                SchemaNode const &node = nodes[active[i]];
+                size_t lo = frame.is_list ? node.min_items : node.min_properties;
+                size_t hi = frame.is_list ? node.max_items : node.max_properties;
+                if (count < lo || count > hi)
+                {
+                    char const *keyword = frame.is_list ? (count < lo ? "minItems" : "maxItems")
+                                                        : (count < lo ? "minProperties" : "maxProperties");
+                    return fail(keyword, frames.size() - 1);
+                }
+                // required 只约束字典
+                for (size_t r = 0; !frame.is_list && r < node.num_required; r++)
+                {
+                    if (!seen[seen_at + r])
+                    {
+                        return fail("required", frames.size() - 1);
+                    }
+                }
+                seen_at += node.num_required;
+            }
+            active.resize(frame.schemas_begin);
+            seen.resize(frame.seen_begin);
+            frames.pop_back();
+        }
+    };
+}
+
+// 编译好的 schema，只读，可以在多个线程间共享
+class Schema
+{
+public:
+    // schema 本身不合法或用到了不支持的关键字（$ref、pattern 等）时返回 nullptr，原因写进 error
+    static std::shared_ptr<Schema const> compile(JSONObject const &schema, std::string *error = nullptr)
+    {
+        _schema_details::_compiler compiler;
+        if (compiler.compile(schema) == _schema_details::none)
+        {
+            if (error != nullptr)
+            {
+                *error = std::move(compiler.error);
+            }
+            return nullptr;
+        }
+        auto res = std::make_shared<Schema>();
+        res->nodes = std::move(compiler.nodes);
+        return res;
+    }
+
+    // 校验解析好的文档
+    SchemaError validate(JSONObject const &doc) const
+    {
+        _schema_details::_tree_validator validator(nodes);
+        validator.check(0, doc);
+        return std::move(validator.error);
+    }
+
+    // 直接校验 JSON 文本，不建树；只有用到 enum、const、uniqueItems、anyOf、oneOf、not 的容器会还原成子树
+    // 字典里重复的键每个都会校验，而 parse 只保留第一个，所以这里可能比 validate(parse(json)) 更严
+    SchemaError validate_json(std::string_view json, ParseOptions const &opts = {}) const
+    {
+        _schema_details::_stream_validator validator(nodes);
+        ParseError err = scan(json, opts, validator);
+        if (err.code != ParseErrc::Ok)
+        {
+            return {"json", "", err};
+        }
+        return std::move(validator.error);
+    }
+
+private:
+    std::vector<_schema_details::SchemaNode> nodes; // nodes[0] 是根
+};
+
+// 按 schema 原文缓存编译结果，同一个 schema 只解析、编译一次
+class SchemaCache
+{
+public:
+    // 原文不是合法 JSON 或编译失败时返回 nullptr，原因写进 error；失败的结果不缓存
+    std::shared_ptr<Schema const> get(std::string_view schema_json, std::string *error = nullptr)
+    {
+        key.assign(schema_json.data(), schema_json.size());
+        auto it = cache.find(key);
+        if (it != cache.end())
+        {
+            return it->second;
+        }
+        ParseResult res = try_parse(schema_json);
+        if (!res.ok())
+        {
+            if (error != nullptr)
+            {
+                *error = parse_error_message(res.error.code);
+            }
+            return nullptr;
+        }
+        auto schema = Schema::compile(res.value, error);
+        if (schema != nullptr)
+        {
+            cache.emplace(key, schema);
+        }
+        return schema;
+    }
+
+    size_t size() const
+    {
+        return cache.size();
+    }
+
+private:
+    std::string key; // 查找时复用的缓冲区
+    std::unordered_map<std::string, std::shared_ptr<Schema const>> cache;
+};
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+#include "json.h"
+#include "persistent.h"
+#include "schema.h"
+
+// Schema 的测试：每个关键字各有通过和不通过的用例，核对报告的 keyword 和 path；
+// 再用随机文档比较 validate(parse(json)) 和 validate_json(json) 的结论
+
+struct SchemaCase
+{
+    char const *schema;
+    char const *json;
+    char const *keyword; // nullptr 表示应当通过
+    char const *path;
+};
+
+// 每个不通过的用例只违反一条规则，两种校验报告的位置必须一样
+inline std::vector<SchemaCase> const &schema_cases()
+{
+    static std::vector<SchemaCase> const cases = {
+        // type
+        {R"({"type": "integer"})", "3", nullptr, ""},
+        {R"({"type": "integer"})", "3.0", nullptr, ""},
+        {R"({"type": "integer"})", "3.5", "type", ""},
+        {R"({"type": "number"})", "3", nullptr, ""},
+        {R"({"type": ["string", "null"]})", "null", nullptr, ""},
+        {R"({"type": ["string", "null"]})", "false", "type", ""},
+        {R"({"type": "object"})", "[]", "type", ""},
+        {R"({"items": {"type": "boolean"}})", "[true, 1]", "type", "/1"},
+        {"false", "1", "false", ""},
+        {"true", R"({"a": [1]})", nullptr, ""},
+        // enum、const
+        {R"({"enum": [1, "a", [true]]})", R"([true])", nullptr, ""},
+        {R"({"enum": [1, "a", [true]]})", "1.0", nullptr, ""},
+        {R"({"enum": [1, "a", [true]]})", R"("b")", "enum", ""},
+        {R"({"const": {"x": [1, null]}})", R"({"x": [1, null]})", nullptr, ""},
+        {R"({"const": {"x": [1, null]}})", R"({"x": [1]})", "enum", ""},
+        {R"({"properties": {"k": {"const": 0}}})", R"({"k": 0.5})", "enum", "/k"},
+        // 数的范围
+        {R"({"minimum": 1, "maximum": 3})", "1", nullptr, ""},
+        {R"({"minimum": 1, "maximum": 3})", "3", nullptr, ""},
+        {R"({"minimum": 1, "maximum": 3})", "0.5", "minimum", ""},
+        {R"({"minimum": 1, "maximum": 3})", "3.5", "maximum", ""},
+        {R"({"exclusiveMinimum": 1})", "1", "exclusiveMinimum", ""},
+        {R"({"exclusiveMinimum": 1})", "1.5", nullptr, ""},
+        {R"({"exclusiveMaximum": 3})", "3", "exclusiveMaximum", ""},
+        {R"({"maximum": 3, "exclusiveMaximum": true})", "3", "exclusiveMaximum", ""},
+        {R"({"maximum": 3, "exclusiveMaximum": true})", "2.9", nullptr, ""},
+        {R"({"minimum": 0})", R"("-1")", nullptr, ""},
+        // multipleOf
+        {R"({"multipleOf": 3})", "-9", nullptr, ""},
+        {R"({"multipleOf": 3})", "10", "multipleOf", ""},
+        {R"({"multipleOf": 1})", "10.0000000001", "multipleOf", ""},
+        {R"({"multipleOf": 0.1})", "0.3", nullptr, ""},
+        {R"({"multipleOf": 0.01})", "19.99", nullptr, ""},
+        {R"({"multipleOf": 1e308})", "1e-308", "multipleOf", ""},
+        {R"({"items": {"multipleOf": 0.5}})", "[1, 1.5, 1.75]", "multipleOf", "/2"},
+        // 长度按码点计
+        {R"({"minLength": 2, "maxLength": 3})", R"("ab")", nullptr, ""},
+        {R"({"minLength": 2, "maxLength": 3})", R"("a")", "minLength", ""},
+        {R"({"minLength": 2, "maxLength": 3})", R"("abcd")", "maxLength", ""},
+        {R"({"maxLength": 2})", R"("é中")", nullptr, ""},
+        {R"({"maxLength": 1})", R"("😀")", nullptr, ""},
+        {R"({"minLength": 1})", "5", nullptr, ""},
+        // items、prefixItems
+        {R"({"minItems": 1, "maxItems": 2})", "[]", "minItems", ""},
+        {R"({"minItems": 1, "maxItems": 2})", "[1, 2, 3]", "maxItems", ""},
+        {R"({"prefixItems": [{"type": "integer"}, {"type": "string"}], "items": {"type": "null"}})", R"([1, "a", null, null])", nullptr, ""},
+        {R"({"prefixItems": [{"type": "integer"}, {"type": "string"}], "items": {"type": "null"}})", R"([1, 2])", "type", "/1"},
+        {R"({"prefixItems": [{"type": "integer"}, {"type": "string"}], "items": {"type": "null"}})", R"([1, "a", 0])", "type", "/2"},
+        {R"({"prefixItems": [{"type": "integer"}], "items": false})", R"([1, 2])", "false", "/1"},
+        {R"({"items": [{"type": "integer"}], "additionalItems": {"type": "string"}})", R"([1, 2])", "type", "/1"},
+        // uniqueItems
+        {R"({"uniqueItems": true})", R"([1, "1", [1], {"a": 1}])", nullptr, ""},
+        {R"({"uniqueItems": true})", R"([{"a": 1, "b": 2}, {"b": 2, "a": 1}])", "uniqueItems", ""},
+        {R"({"uniqueItems": true})", "[1, 1.0]", "uniqueItems", ""},
+        {R"({"uniqueItems": false})", "[1, 1]", nullptr, ""},
+        // properties、required
+        {R"({"properties": {"a": {"type": "integer"}}, "required": ["a"]})", R"({"a": 1, "b": "x"})", nullptr, ""},
+        {R"({"properties": {"a": {"type": "integer"}}, "required": ["a"]})", R"({"b": "x"})", "required", ""},
+        {R"({"properties": {"a": {"type": "integer"}}, "required": ["a"]})", R"({"a": "x"})", "type", "/a"},
+        {R"({"properties": {"a": {"properties": {"b~/c": {"type": "null"}}}}})", R"({"a": {"b~/c": 1}})", "type", "/a/b~0~1c"},
+        {R"({"properties": {"a": {}}, "additionalProperties": false})", R"({"a": 1, "b": 2})", "false", "/b"},
+        {R"({"additionalProperties": {"type": "string"}})", R"({"a": "x", "b": 2})", "type", "/b"},
+        {R"({"minProperties": 1, "maxProperties": 1})", "{}", "minProperties", ""},
+        {R"({"minProperties": 1, "maxProperties": 1})", R"({"a": 1, "b": 2})", "maxProperties", ""},
+        {R"({"required": ["a"]})", "[]", nullptr, ""},
+        // allOf、anyOf、oneOf、not
+        {R"({"allOf": [{"minimum": 0}, {"maximum": 5}]})", "3", nullptr, ""},
+        {R"({"allOf": [{"minimum": 0}, {"maximum": 5}]})", "6", "maximum", ""},
+        {R"({"anyOf": [{"type": "string"}, {"minimum": 10}]})", R"("x")", nullptr, ""},
+        {R"({"anyOf": [{"type": "string"}, {"minimum": 10}]})", "11", nullptr, ""},
+        {R"({"anyOf": [{"type": "string"}, {"minimum": 10}]})", "9", "anyOf", ""},
+        {R"({"oneOf": [{"type": "integer"}, {"minimum": 2}]})", "1", nullptr, ""},
+        {R"({"oneOf": [{"type": "integer"}, {"minimum": 2}]})", "2.5", nullptr, ""},
+        {R"({"oneOf": [{"type": "integer"}, {"minimum": 2}]})", "3", "oneOf", ""},
+        {R"({"oneOf": [{"type": "integer"}, {"minimum": 2}]})", "1.5", "oneOf", ""},
+        {R"({"not": {"type": "null"}})", "0", nullptr, ""},
+        {R"({"not": {"type": "null"}})", "null", "not", ""},
+        {R"({"items": {"anyOf": [{"type": "integer"}, {"type": "array", "items": {"type": "integer"}}]}})", R"([1, [2, 3], [4, "x"]])", "anyOf", "/2"},
+        {R"({"properties": {"a": {"not": {"const": [1]}}}})", R"({"a": [1]})", "not", "/a"},
+    };
+    return cases;
+}
+
+// 不合法的 schema 必须编译失败
+inline std::vector<char const *> const &invalid_schemas()
+{
+    static std::vector<char const *> const schemas = {
+        R"({"type": "float"})", R"({"enum": 1})", R"({"minimum": "0"})", R"({"multipleOf": 0})", R"({"multipleOf": -1})",
+        R"({"minLength": -1})", R"({"maxItems": 1.5})", R"({"prefixItems": {}})", R"({"required": [1]})",
+        R"({"anyOf": []})", R"({"$ref": "#"})", R"({"properties": {"a": 1}})", "1",
+    };
+    return schemas;
+}
+
+// 比较两种校验的结论；出错时两边的关键字和路径都必须落在文档里存在的值上
+// 有多处违反时两边遍历字典的顺序不同，报告的可能不是同一处，所以随机文档只比较结论
+inline bool same_schema_verdict(Schema const &schema, std::string_view json, ParseResult const &doc)
+{
+    SchemaError tree = schema.validate(doc.value);
+    SchemaError stream = schema.validate_json(json);
+    PersistentJSON root(doc.value);
+    auto valid_error = [&](SchemaError const &err)
+    {
+        return err.ok() || root.find_pointer(err.path) != nullptr;
+    };
+    if (tree.ok() != stream.ok() || !valid_error(tree) || !valid_error(stream))
+    {
+        std::string quoted;
+        escape_string(json, quoted);
+        print("schema verdicts disagree on input", quoted.c_str());
+        print("  validate:     ", tree);
+        print("  validate_json:", stream);
+        return false;
+    }
+    return true;
+}
+
+// 校验用的随机文档：值取自一个小集合，容易碰到各个关键字的边界；
+// 字典里的键不重复，重复的键 validate_json 比 validate 更严（见 schema.h）
+struct SchemaDocGenerator
+{
+    std::mt19937_64 rng;
+
+    size_t pick(size_t n)
+    {
+        return rng() % n;
+    }
+
+    void value(std::string &out, int depth)
+    {
+        static char const *const scalars[] = {"0", "1", "3", "-3", "9", "0.5", "1.5", "2.25", "-0.0", "1e3", "\"\"", "\"a\"",
+                                              "\"ab\"", "\"abcde\"", "\"\\u00e9\\u4e2d\"", "true", "false", "null"};
+        static char const *const keys[] = {"id", "name", "tags", "a", "b", "x"};
+        size_t kind = depth > 0 ? pick(6) : 5;
+        if (kind < 2)
+        {
+            out += '[';
+            for (size_t i = 0, n = pick(5); i < n; i++)
+            {
+                out += i == 0 ? "" : ", ";
+                value(out, depth - 1);
+            }
+            out += ']';
+        }
+        else if (kind < 4)
+        {
+            out += '{';
+            size_t mask = pick(1 << std::size(keys));
+            bool first = true;
+            for (size_t i = 0; i < std::size(keys); i++)
+            {
+                if (mask >> i & 1)
+                {
+                    out += first ? "\"" : ", \"";
+                    out += keys[i];
+                    out += "\": ";
+                    value(out, depth - 1);
+                    first = false;
+                }
+            }
+            out += '}';
+        }
+        else
+        {
+            out += scalars[pick(std::size(scalars))];
+        }
+    }
+};
+
+// 按关键字逐条检查，再对随机文档比较两种校验，返回是否全部通过
+inline bool check_schema(size_t count)
+{
+    bool ok = true;
+    for (auto const &c : schema_cases())
+    {
+        std::string error;
+        auto schema = Schema::compile(try_parse(c.schema).value, &error);
+        if (schema == nullptr)
+        {
+            print("schema", c.schema, "failed to compile:", error.c_str());
+            ok = false;
+            continue;
+        }
+        SchemaError tree = schema->validate(try_parse(c.json).value);
+        SchemaError stream = schema->validate_json(c.json);
+        for (SchemaError const *got : {&tree, &stream})
+        {
+            bool expected = c.keyword == nullptr ? got->ok()
+                                                 : !got->ok() && std::strcmp(got->keyword, c.keyword) == 0 && got->path == c.path;
+            if (!expected)
+            {
+                print("schema", c.schema, "on", c.json, got == &tree ? "(validate):" : "(validate_json):", *got);
+                ok = false;
+            }
+        }
+    }
+    for (char const *text : invalid_schemas())
+    {
+        if (Schema::compile(try_parse(text).value) != nullptr)
+        {
+            print("invalid schema", text, "compiled");
+            ok = false;
+        }
+    }
+
+    // 随机文档对这几个 schema 既有通过的也有不通过的，合起来覆盖了大部分关键字
+    static char const *const schemas[] = {
+        R"({"required": ["x"], "properties": {
+            "id": {"type": "integer", "minimum": 0, "multipleOf": 3},
+            "name": {"type": "string", "minLength": 1, "maxLength": 4},
+            "tags": {"type": "array", "items": {"type": "string"}, "uniqueItems": true, "maxItems": 3}}})",
+        R"({"minItems": 1, "prefixItems": [{"type": "integer"}, {"type": "string"}], "items": {"type": ["number", "null", "array"]}})",
+        R"({"oneOf": [{"type": "integer"}, {"type": "number", "exclusiveMaximum": 1.5}, {"enum": [true, "a", [1]]}], "not": {"const": 0}})",
+        R"({"items": {"minProperties": 1, "properties": {
+            "a": {"allOf": [{"minimum": -1}, {"maximum": 2}]},
+            "b": {"anyOf": [{"type": "null"}, {"const": [1, "a"]}]}},
+            "additionalProperties": {"type": ["boolean", "array"]}}})",
+        R"({"anyOf": [{"type": "array", "items": {"type": "array", "maxItems": 2}}, {"type": "object", "additionalProperties": false}]})",
+    };
+    std::vector<std::shared_ptr<Schema const>> compiled;
+    for (char const *text : schemas)
+    {
+        std::string error;
+        if (auto schema = Schema::compile(try_parse(text).value, &error))
+        {
+            compiled.push_back(std::move(schema));
+        }
+        else
+        {
+            print("schema", text, "failed to compile:", error.c_str());
+            ok = false;
+        }
+    }
+    SchemaDocGenerator gen{std::mt19937_64(20240611)};
+    size_t failed = 0;
+    bool agree = true;
+    for (size_t i = 0; i < count && agree; i++)
+    {
+        std::string json;
+        gen.value(json, 3);
+        ParseResult doc = try_parse(json);
+        for (auto const &schema : compiled)
+        {
+            agree &= same_schema_verdict(*schema, json, doc);
+            failed += !schema->validate(doc.value).ok();
+        }
+    }
+    print("schema:", schema_cases().size(), "keyword cases,", invalid_schemas().size(), "invalid schemas,", count, "documents x",
+          compiled.size(), "schemas,", failed, "rejected");
+    return ok && agree;
+}
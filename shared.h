@@ -0,0 +1,242 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "json.h"
+#include "snapshot.h"
+
+// 多进程共享的只读文档：文档写成快照镜像（见 snapshot.h，只有偏移没有指针，映射到哪个地址都能读）放进 POSIX 共享内存，
+// 各个进程映射同一份物理内存直接读，不用各自解析、各存一份
+//
+// 名为 name 的控制段里只有版本号；版本 v 的镜像放在单独的段 name.v 里，写好之后不再修改
+// 发布时先写好新段，再原子地把当前版本改过去，最后删掉旧段的名字；已经映射了旧段的读者照常读，下次 current() 时换到新版本
+//
+//     // 写者进程，每次重新加载配置时
+//     shared_publish("/app-config", config);
+//     // 读者进程
+//     auto doc = SharedDocument::open("/app-config");
+//     auto snap = doc->current(); // 每个请求开始时取一次，请求内一直用它
+//     auto timeout = snap->root().find("timeout");
+
+#if defined(__unix__) || defined(__APPLE__)
+
+namespace _shared_details {
+    struct Control
+    {
+        std::atomic<uint64_t> next;    // 最后分配出去的版本号
+        std::atomic<uint64_t> current; // 当前版本，0 表示还没有发布过
+    };
+
+    // 跨进程用的原子变量必须无锁；新建的段全是 0，正好是两个计数器的初值
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+    inline bool fail(std::string what, std::string *error)
+    {
+        if (error != nullptr)
+        {
+            *error = std::move(what);
+        }
+        return false;
+    }
+
+    inline std::string segment_name(std::string const &name, uint64_t version)
+    {
+        return name + "." + std::to_string(version);
+    }
+
+    // 映射控制段，writable 时没有就新建；失败返回 nullptr
+    inline Control *map_control(std::string const &name, bool writable, std::string *error)
+    {
+        int fd = shm_open(name.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+        if (fd < 0)
+        {
+            fail("cannot open " + name, error);
+            return nullptr;
+        }
+        // 几个写者同时新建时都截到同样的长度，不会互相覆盖
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 &&
+                  (size_t(st.st_size) >= sizeof(Control) || (writable && ftruncate(fd, sizeof(Control)) == 0));
+        void *p = ok ? mmap(nullptr, sizeof(Control), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0)
+                     : MAP_FAILED;
+        close(fd);
+        if (p == MAP_FAILED)
+        {
+            fail(ok ? "cannot mmap " + name : name + " is not a shared document", error);
+            return nullptr;
+        }
+        return static_cast<Control *>(p);
+    }
+
+    // 新建段 seg 并写入 image
+    inline bool write_segment(std::string const &seg, std::string const &image, std::string *error)
+    {
+        int fd = shm_open(seg.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+        {
+            return fail("cannot create " + seg, error);
+        }
+        void *p = ftruncate(fd, off_t(image.size())) == 0
+                      ? mmap(nullptr, image.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                      : MAP_FAILED;
+        close(fd);
+        if (p == MAP_FAILED)
+        {
+            shm_unlink(seg.c_str());
+            return fail("cannot mmap " + seg, error);
+        }
+        std::memcpy(p, image.data(), image.size());
+        munmap(p, image.size());
+        return true;
+    }
+}
+
+// 把 obj 发布为 name 的新版本，控制段不存在时新建；name 按 shm_open 的要求以 '/' 开头
+// 返回新的版本号，失败返回 0，原因写进 error；几个写者同时发布时版本号大的生效，被抢先的一方也返回 0
+inline uint64_t shared_publish(std::string const &name, JSONObject const &obj, std::string *error = nullptr)
+{
+    using namespace _shared_details;
+    std::string image = snapshot_write(obj);
+    Control *control = map_control(name, true, error);
+    if (control == nullptr)
+    {
+        return 0;
+    }
+    uint64_t version = control->next.fetch_add(1) + 1;
+    std::string seg = segment_name(name, version);
+    if (!write_segment(seg, image, error))
+    {
+        munmap(control, sizeof(Control));
+        return 0;
+    }
+    uint64_t old = control->current.load();
+    while (old < version && !control->current.compare_exchange_weak(old, version))
+    {
+    }
+    munmap(control, sizeof(Control));
+    // 删掉被换下来的旧版本，或者没能发布出去的这一版
+    if (old > version)
+    {
+        shm_unlink(seg.c_str());
+        fail("a newer version of " + name + " was published concurrently", error);
+        return 0;
+    }
+    if (old != 0)
+    {
+        shm_unlink(segment_name(name, old).c_str());
+    }
+    return version;
+}
+
+// 删掉 name 的控制段和当前版本；已经映射的读者不受影响
+inline void shared_remove(std::string const &name)
+{
+    using namespace _shared_details;
+    if (Control *control = map_control(name, false, nullptr))
+    {
+        uint64_t current = control->current.load();
+        munmap(control, sizeof(Control));
+        if (current != 0)
+        {
+            shm_unlink(segment_name(name, current).c_str());
+        }
+    }
+    shm_unlink(name.c_str());
+}
+
+// 读者进程里的共享文档，可以在多个线程间共享
+class SharedDocument
+{
+public:
+    SharedDocument() = default;
+    SharedDocument(SharedDocument const &) = delete;
+    SharedDocument &operator=(SharedDocument const &) = delete;
+
+    ~SharedDocument()
+    {
+        if (control != nullptr)
+        {
+            munmap(const_cast<_shared_details::Control *>(control), sizeof(_shared_details::Control));
+        }
+    }
+
+    // 打开已经发布过的 name，失败返回 nullptr，原因写进 error
+    static std::shared_ptr<SharedDocument> open(std::string name, std::string *error = nullptr)
+    {
+        auto res = std::make_shared<SharedDocument>();
+        res->control = _shared_details::map_control(name, false, error);
+        if (res->control == nullptr)
+        {
+            return nullptr;
+        }
+        res->name = std::move(name);
+        return res;
+    }
+
+    // 当前版本的快照，发布过新版本时先换成新的映射；换不成时继续返回旧的（从没成功过则为 nullptr），原因写进 error
+    // 返回的快照可以一直持有，旧版本的映射在最后一个持有者释放时解除
+    std::shared_ptr<Snapshot const> current(std::string *error = nullptr)
+    {
+        uint64_t version = control->current.load();
+        std::lock_guard<std::mutex> lock(mutex);
+        // 版本号只增不减，为 0 时一定从没发布过，loaded 也还是 0
+        if (version == 0)
+        {
+            _shared_details::fail(name + " has not been published", error);
+            return snapshot;
+        }
+        while (version != loaded)
+        {
+            std::string seg = _shared_details::segment_name(name, version);
+            int fd = shm_open(seg.c_str(), O_RDONLY, 0);
+            if (fd >= 0)
+            {
+                auto snap = Snapshot::map(fd, seg, error);
+                close(fd);
+                if (snap != nullptr)
+                {
+                    snapshot = std::move(snap);
+                    loaded = version;
+                }
+                break;
+            }
+            // 读到版本号之后又发布了一版，旧段已经删掉，重读版本号
+            int err = errno;
+            uint64_t again = control->current.load();
+            if (err != ENOENT || again == version)
+            {
+                _shared_details::fail("cannot open " + seg, error);
+                break;
+            }
+            version = again;
+        }
+        return snapshot;
+    }
+
+    // current() 最近换上的版本号
+    uint64_t version() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return loaded;
+    }
+
+private:
+    std::string name;
+    _shared_details::Control const *control = nullptr;
+    mutable std::mutex mutex;
+    uint64_t loaded = 0;
+    std::shared_ptr<Snapshot const> snapshot;
+};
+
+#endif
@@ -0,0 +1,612 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "json.h"
+
+// 文档快照：把 JSONObject 写成一块不含指针的二进制镜像，读的时候 mmap 上来直接按偏移访问，不用再解析
+// 镜像按本机字节序写，换了字节序的机器上打开会失败
+//
+// 布局：Header 之后依次是各个值的 Entry 数组和字符串，全部 8 字节对齐
+// 每个值是一个 16 字节的 Entry：head 低 8 位是类型（和 JSONObject::inner 的下标一致），高 56 位是长度；
+// payload 对 null、bool、int、double 是值本身，对字符串、列表、字典是内容相对镜像开头的偏移
+// 字符串内容后面补一个 '\0'；列表的内容是 n 个 Entry；字典是 n 对 (键, 值) Entry，按键的字节序排好，查找用二分
+
+namespace _snapshot_details {
+    struct Entry
+    {
+        uint64_t head;
+        uint64_t payload;
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t size; // 整个镜像的字节数
+        Entry root;
+    };
+
+    constexpr char magic[8] = {'B', 'J', 'S', 'N', 'A', 'P', '\r', '\n'};
+    constexpr uint32_t version = 1;
+    constexpr uint32_t byte_order = 0x01020304;
+
+    struct _writer
+    {
+        std::string &out;
+        size_t base; // 镜像在 out 里的起始位置
+
+        // 在末尾分配 bytes 字节（补齐到 8 字节），返回相对镜像开头的偏移
+        size_t alloc(size_t bytes)
+        {
+            size_t off = (out.size() - base + 7) & ~size_t(7);
+            out.resize(base + off + bytes);
+            return off;
+        }
+
+        void set(size_t at, Entry e)
+        {
+            std::memcpy(&out[base + at], &e, sizeof(e));
+        }
+
+        void put_string(std::string_view str, size_t at)
+        {
+            size_t off = alloc(str.size() + 1);
+            std::memcpy(&out[base + off], str.data(), str.size());
+            set(at, {json_index<std::string> | uint64_t(str.size()) << 8, off});
+        }
+
+        // 把 obj 的内容追加到末尾，再把它的 Entry 填到 at 处；子节点的偏移总是大于父节点
+        void put(JSONObject const &obj, size_t at)
+        {
+            uint64_t type = obj.inner.index();
+            std::visit(
+                overloaded{
+                    [&](std::nullptr_t)
+                    {
+                        set(at, {type, 0});
+                    },
+                    [&](bool val)
+                    {
+                        set(at, {type, uint64_t(val)});
+                    },
+                    [&](int val)
+                    {
+                        set(at, {type, uint64_t(int64_t(val))});
+                    },
+                    [&](double val)
+                    {
+                        uint64_t bits;
+                        std::memcpy(&bits, &val, 8);
+                        set(at, {type, bits});
+                    },
+                    [&](std::string const &val)
+                    {
+                        put_string(val, at);
+                    },
+                    [&](JSONList const &val)
+                    {
+                        size_t off = alloc(val.size() * sizeof(Entry));
+                        for (size_t i = 0; i < val.size(); i++)
+                        {
+                            put(val[i], off + i * sizeof(Entry));
+                        }
+                        set(at, {type | uint64_t(val.size()) << 8, off});
+                    },
+                    [&](JSONDict const &val)
+                    {
+                        std::vector<JSONDict::value_type const *> items;
+                        items.reserve(val.size());
+                        for (auto const &item : val)
+                        {
+                            items.push_back(&item);
+                        }
+                        std::sort(items.begin(), items.end(), [](auto a, auto b)
+                                  { return std::string_view(a->first) < std::string_view(b->first); });
+                        size_t off = alloc(items.size() * 2 * sizeof(Entry));
+                        for (size_t i = 0; i < items.size(); i++)
+                        {
+                            put_string(items[i]->first, off + 2 * i * sizeof(Entry));
+                            put(items[i]->second, off + (2 * i + 1) * sizeof(Entry));
+                        }
+                        set(at, {type | uint64_t(items.size()) << 8, off});
+                    },
+                },
+                obj.inner);
+        }
+    };
+
+    // 完整检查一个不可信的镜像：类型、偏移、长度都在界内，字典的键有序，字符串是合法 UTF-8
+    // _writer 按先序依次分配各块内容，检查时按同样的顺序要求每块都从上一块之后开始，这样块之间不会重叠、共享或成环，检查是线性的
+    struct _checker
+    {
+        char const *data;
+        size_t size;
+        size_t next = sizeof(Header); // 下一块内容最早的起点
+        std::string error;
+
+        bool fail(char const *what)
+        {
+            error = what;
+            return false;
+        }
+
+        // 占下从 off 开始的 count 个 width 字节的块
+        bool claim(uint64_t off, uint64_t count, uint64_t width)
+        {
+            if (off < next || off % 8 != 0 || off > size || count > (size - off) / width)
+            {
+                return false;
+            }
+            next = off + count * width;
+            return true;
+        }
+
+        bool string(Entry const &e)
+        {
+            uint64_t n = e.head >> 8;
+            if (n == UINT64_MAX >> 8 || !claim(e.payload, n + 1, 1))
+            {
+                return fail("string out of bounds");
+            }
+            if (data[e.payload + n] != '\0' || !utf8_validate(data + e.payload, n))
+            {
+                return fail("malformed string");
+            }
+            return true;
+        }
+
+        // 待检查的 Entry；字典的键要和前一个键比较顺序，单独标出来
+        enum class Slot
+        {
+            value,
+            first_key,
+            key,
+        };
+
+        // 按前序检查 at 处的值，用显式的栈而不是递归，嵌套再深也不会爆栈
+        bool check(size_t at)
+        {
+            std::vector<std::pair<size_t, Slot>> stack{{at, Slot::value}};
+            while (!stack.empty())
+            {
+                auto [off, slot] = stack.back();
+                stack.pop_back();
+                Entry e;
+                std::memcpy(&e, data + off, sizeof(e));
+                if (slot != Slot::value)
+                {
+                    if (!key(e, off, slot == Slot::first_key))
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                uint64_t n = e.head >> 8;
+                switch (e.head & 0xFF)
+                {
+                case json_index<std::nullptr_t>:
+                    if (n != 0 || e.payload != 0)
+                    {
+                        return fail("malformed null");
+                    }
+                    break;
+                case json_index<bool>:
+                    if (n != 0 || e.payload > 1)
+                    {
+                        return fail("malformed bool");
+                    }
+                    break;
+                case json_index<int>:
+                    if (n != 0 || int64_t(e.payload) != int(e.payload))
+                    {
+                        return fail("malformed int");
+                    }
+                    break;
+                case json_index<double>:
+                    if (n != 0)
+                    {
+                        return fail("malformed double");
+                    }
+                    break;
+                case json_index<std::string>:
+                    if (!string(e))
+                    {
+                        return false;
+                    }
+                    break;
+                case json_index<JSONList>:
+                    if (!claim(e.payload, n, sizeof(Entry)))
+                    {
+                        return fail("list out of bounds");
+                    }
+                    // 倒着压栈，弹出的顺序就是前序，和 claim 要求的一致
+                    for (uint64_t i = n; i-- > 0;)
+                    {
+                        stack.emplace_back(e.payload + i * sizeof(Entry), Slot::value);
+                    }
+                    break;
+                case json_index<JSONDict>:
+                    if (!claim(e.payload, n, 2 * sizeof(Entry)))
+                    {
+                        return fail("dict out of bounds");
+                    }
+                    for (uint64_t i = n; i-- > 0;)
+                    {
+                        size_t k = e.payload + 2 * i * sizeof(Entry);
+                        stack.emplace_back(k + sizeof(Entry), Slot::value);
+                        stack.emplace_back(k, i == 0 ? Slot::first_key : Slot::key);
+                    }
+                    break;
+                default:
+                    return fail("unknown type");
+                }
+            }
+            return true;
+        }
+
+        // off 处的键，不是第一个时要大于紧挨在前面的键（已经检查过）
+        bool key(Entry const &e, size_t off, bool first)
+        {
+            if ((e.head & 0xFF) != json_index<std::string> || !string(e))
+            {
+                return fail("malformed key");
+            }
+            if (!first)
+            {
+                Entry prev;
+                std::memcpy(&prev, data + off - 2 * sizeof(Entry), sizeof(prev));
+                if (!(std::string_view(data + prev.payload, prev.head >> 8) < std::string_view(data + e.payload, e.head >> 8)))
+                {
+                    return fail("keys not sorted");
+                }
+            }
+            return true;
+        }
+    };
+}
+
+// 快照里的一个值，只是 (镜像, Entry) 的指针对，复制很便宜；所属的 Snapshot 必须比它活得久
+// 类型判断用 is<T>()，T 和 JSONObject 一样取 std::nullptr_t、bool、int、double、std::string、JSONList、JSONDict
+class SnapshotValue
+{
+public:
+    SnapshotValue(char const *data, _snapshot_details::Entry const *entry) : data(data), entry(entry)
+    {
+    }
+
+    size_t index() const
+    {
+        return entry->head & 0xFF;
+    }
+
+    template <class T>
+    bool is() const
+    {
+        return index() == json_index<T>;
+    }
+
+    bool as_bool() const
+    {
+        return entry->payload != 0;
+    }
+
+    int as_int() const
+    {
+        return int(int64_t(entry->payload));
+    }
+
+    double as_double() const
+    {
+        double val;
+        std::memcpy(&val, &entry->payload, 8);
+        return val;
+    }
+
+    // 指向镜像内部，后面保证有 '\0'
+    std::string_view as_string() const
+    {
+        return {data + entry->payload, size()};
+    }
+
+    // 字符串的字节数，列表、字典的元素个数
+    size_t size() const
+    {
+        return entry->head >> 8;
+    }
+
+    // 列表的第 i 个元素
+    SnapshotValue operator[](size_t i) const
+    {
+        return {data, items() + i};
+    }
+
+    // 字典按键排好序的第 i 项
+    std::string_view key(size_t i) const
+    {
+        return SnapshotValue(data, items() + 2 * i).as_string();
+    }
+
+    SnapshotValue value(size_t i) const
+    {
+        return {data, items() + 2 * i + 1};
+    }
+
+    // 在字典里二分查找 key
+    std::optional<SnapshotValue> find(std::string_view k) const
+    {
+        size_t lo = 0, hi = size();
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            std::string_view cur = key(mid);
+            if (cur == k)
+            {
+                return value(mid);
+            }
+            if (cur < k)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // 还原成 JSONObject
+    JSONObject to_object() const
+    {
+        switch (index())
+        {
+        case json_index<bool>:
+            return JSONObject{as_bool()};
+        case json_index<int>:
+            return JSONObject{as_int()};
+        case json_index<double>:
+            return JSONObject{as_double()};
+        case json_index<std::string>:
+            return JSONObject{std::string(as_string())};
+        case json_index<JSONList>:
+        {
+            JSONList res;
+            res.reserve(size());
+            for (size_t i = 0; i < size(); i++)
+            {
+                res.push_back((*this)[i].to_object());
+            }
+            return JSONObject{std::move(res)};
+        }
+        case json_index<JSONDict>:
+        {
+            JSONDict res;
+            res.reserve(size());
+            for (size_t i = 0; i < size(); i++)
+            {
+                res.try_emplace(std::string(key(i)), value(i).to_object());
+            }
+            return JSONObject{std::move(res)};
+        }
+        default:
+            return JSONObject{std::nullptr_t{}};
+        }
+    }
+
+private:
+    _snapshot_details::Entry const *items() const
+    {
+        return reinterpret_cast<_snapshot_details::Entry const *>(data + entry->payload);
+    }
+
+    char const *data;
+    _snapshot_details::Entry const *entry;
+};
+
+// 把 obj 写成快照镜像追加到 out；out 原有内容的长度要是 8 的倍数，否则镜像内部不对齐
+inline void snapshot_write(JSONObject const &obj, std::string &out)
+{
+    using namespace _snapshot_details;
+    size_t base = out.size();
+    out.resize(base + sizeof(Header));
+    _writer writer{out, base};
+    writer.put(obj, offsetof(Header, root));
+    Header header;
+    std::memcpy(&header, &out[base], sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byte_order = byte_order;
+    header.size = out.size() - base;
+    std::memcpy(&out[base], &header, sizeof(header));
+}
+
+inline std::string snapshot_write(JSONObject const &obj)
+{
+    std::string out;
+    snapshot_write(obj, out);
+    return out;
+}
+
+// 把 obj 写成快照文件，失败时原因写进 error
+inline bool snapshot_save(JSONObject const &obj, std::string const &path, std::string *error = nullptr)
+{
+    std::string image = snapshot_write(obj);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(image.data(), image.size()) || !file.flush())
+    {
+        if (error != nullptr)
+        {
+            *error = "cannot write " + path;
+        }
+        return false;
+    }
+    return true;
+}
+
+// 打开的快照，只读，可以在多个线程间共享
+// open/from_bytes 只检查文件头，时间和文档大小无关；来源不可信时先调用 check() 完整检查一遍
+class Snapshot
+{
+public:
+    Snapshot() = default;
+    Snapshot(Snapshot const &) = delete;
+    Snapshot &operator=(Snapshot const &) = delete;
+
+    ~Snapshot()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped != nullptr)
+        {
+            munmap(mapped, length);
+        }
+#endif
+    }
+
+    // mmap 整个文件，不支持 mmap 的平台上退化为读进内存；文件打不开或文件头不对时返回 nullptr，原因写进 error
+    static std::shared_ptr<Snapshot const> open(std::string const &path, std::string *error = nullptr)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return fail("cannot open " + path, error);
+        }
+        auto mapped = map(fd, path, error);
+        close(fd);
+        return mapped;
+#else
+        auto res = std::make_shared<Snapshot>();
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return fail("cannot open " + path, error);
+        }
+        res->owned.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        res->data = res->owned.data();
+        res->length = res->owned.size();
+        return finish(std::move(res), error);
+#endif
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    // 只读 mmap 已经打开的 fd 的全部内容，fd 由调用者关闭；name 只用于错误信息
+    static std::shared_ptr<Snapshot const> map(int fd, std::string const &name, std::string *error = nullptr)
+    {
+        auto res = std::make_shared<Snapshot>();
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            return fail("cannot open " + name, error);
+        }
+        res->length = size_t(st.st_size);
+        if (res->length > 0)
+        {
+            void *p = mmap(nullptr, res->length, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                return fail("cannot mmap " + name, error);
+            }
+            res->mapped = p;
+            res->data = static_cast<char const *>(p);
+        }
+        return finish(std::move(res), error);
+    }
+#endif
+
+    // 接管一块内存里的镜像，比如 snapshot_write 的结果
+    static std::shared_ptr<Snapshot const> from_bytes(std::string image, std::string *error = nullptr)
+    {
+        auto res = std::make_shared<Snapshot>();
+        res->owned = std::move(image);
+        res->data = res->owned.data();
+        res->length = res->owned.size();
+        return finish(std::move(res), error);
+    }
+
+    SnapshotValue root() const
+    {
+        return {data, reinterpret_cast<_snapshot_details::Entry const *>(data + offsetof(_snapshot_details::Header, root))};
+    }
+
+    std::string_view bytes() const
+    {
+        return {data, length};
+    }
+
+    // 遍历整个镜像做完整检查，时间和镜像大小成正比；失败时原因写进 error
+    bool check(std::string *error = nullptr) const
+    {
+        _snapshot_details::_checker checker{data, length, sizeof(_snapshot_details::Header), {}};
+        if (!checker.check(offsetof(_snapshot_details::Header, root)))
+        {
+            if (error != nullptr)
+            {
+                *error = std::move(checker.error);
+            }
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static std::shared_ptr<Snapshot const> fail(std::string what, std::string *error)
+    {
+        if (error != nullptr)
+        {
+            *error = std::move(what);
+        }
+        return nullptr;
+    }
+
+    // 检查文件头，通过时返回 res
+    static std::shared_ptr<Snapshot const> finish(std::shared_ptr<Snapshot> res, std::string *error)
+    {
+        using namespace _snapshot_details;
+        Header header;
+        if (res->length < sizeof(header) || reinterpret_cast<uintptr_t>(res->data) % 8 != 0)
+        {
+            return fail("not a snapshot", error);
+        }
+        std::memcpy(&header, res->data, sizeof(header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+        {
+            return fail("not a snapshot", error);
+        }
+        if (header.byte_order != byte_order)
+        {
+            return fail("snapshot has a different byte order", error);
+        }
+        if (header.version != version)
+        {
+            return fail("unsupported snapshot version", error);
+        }
+        if (header.size != res->length)
+        {
+            return fail("snapshot size mismatch", error);
+        }
+        return res;
+    }
+
+    std::string owned;      // from_bytes 或不支持 mmap 时持有镜像
+    void *mapped = nullptr; // mmap 的地址
+    char const *data = nullptr;
+    size_t length = 0;
+};
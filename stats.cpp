@@ -0,0 +1,25 @@
+#include <cstdlib>
+#include <new>
+#include "stats.h"
+
+// 替换全局的 operator new/delete，为 ParseStats 统计堆分配，只在 BABYJSON_STATS 构建中链接
+void *operator new(std::size_t size)
+{
+    _stats_details::allocations++;
+    _stats_details::bytes_allocated += size;
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <tuple>
+#include "json.h"
+
+#if BABYJSON_STATS
+
+namespace _stats_details {
+    // 由 stats.cpp 里替换的 operator new 累加，只统计当前线程
+    inline thread_local size_t allocations = 0;
+    inline thread_local size_t bytes_allocated = 0;
+}
+
+struct ParseStats
+{
+    static constexpr size_t num_types = std::variant_size_v<decltype(JSONObject::inner)>;
+
+    size_t allocations = 0;
+    size_t bytes_allocated = 0;
+    size_t nodes[num_types] = {}; // 下标同 JSONObject::inner.index()
+    size_t max_depth = 0;
+    size_t bytes_scanned = 0;
+
+    void do_print() const
+    {
+        static char const *const names[num_types] = {"null", "bool", "int", "double", "string", "list", "dict"};
+        std::cout << "{allocations: " << allocations << ", bytes_allocated: " << bytes_allocated
+                  << ", max_depth: " << max_depth << ", bytes_scanned: " << bytes_scanned << ", nodes: {";
+        for (size_t i = 0; i < num_types; i++)
+        {
+            std::cout << (i ? ", " : "") << names[i] << ": " << nodes[i];
+        }
+        std::cout << "}}";
+    }
+};
+
+// 遍历解析结果统计各类型节点数和最大深度，不在解析的热路径上增加任何开销
+inline void count_nodes(JSONObject const &obj, size_t depth, ParseStats &stats)
+{
+    stats.nodes[obj.inner.index()]++;
+    stats.max_depth = std::max(stats.max_depth, depth);
+    if (auto *list = std::get_if<JSONList>(&obj.inner))
+    {
+        for (auto const &v : *list)
+        {
+            count_nodes(v, depth + 1, stats);
+        }
+    }
+    else if (auto *dict = std::get_if<JSONDict>(&obj.inner))
+    {
+        for (auto const &[k, v] : *dict)
+        {
+            count_nodes(v, depth + 1, stats);
+        }
+    }
+}
+
+// 执行 f() 并统计期间本线程的堆分配次数和字节数
+template <class F>
+void count_allocations(ParseStats &stats, F &&f)
+{
+    size_t allocations = _stats_details::allocations;
+    size_t bytes_allocated = _stats_details::bytes_allocated;
+    f();
+    stats.allocations += _stats_details::allocations - allocations;
+    stats.bytes_allocated += _stats_details::bytes_allocated - bytes_allocated;
+}
+
+// 带统计的 parse：auto [obj, eaten, stats] = parse_with_stats(json);
+inline std::tuple<JSONObject, size_t, ParseStats> parse_with_stats(std::string_view json, ParseOptions const &opts = {})
+{
+    ParseStats stats;
+    std::pair<JSONObject, size_t> res;
+    count_allocations(stats, [&]
+                      { res = parse(json, opts); });
+    stats.bytes_scanned = res.second;
+    if (res.second != 0)
+    {
+        count_nodes(res.first, 1, stats);
+    }
+    return {std::move(res.first), res.second, stats};
+}
+
+// 带统计的 Document::parse，复用节点后 allocations 应降到 0
+inline ParseStats parse_with_stats(Document &doc, std::string_view json)
+{
+    ParseStats stats;
+    size_t eaten = 0;
+    count_allocations(stats, [&]
+                      { eaten = doc.parse(json); });
+    stats.bytes_scanned = eaten;
+    if (eaten != 0)
+    {
+        count_nodes(doc.root, 1, stats);
+    }
+    return stats;
+}
+
+#endif
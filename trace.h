@@ -0,0 +1,116 @@
+#pragma once
+
+// 解析各阶段的计时，默认不编译；-DBABYJSON_TRACE=1 时 BABYJSON_TRACE_SCOPE 在作用域结束时记一次耗时
+
+#if BABYJSON_TRACE
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <iostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum class TracePhase
+{
+    Whitespace,
+    String,
+    Number,
+    Container,
+};
+
+namespace _trace_details {
+    constexpr size_t num_phases = 4;
+    constexpr size_t num_buckets = 40;
+
+    // 按耗时的 log2 分桶，第 k 桶为 [2^k, 2^(k+1)) 个周期
+    struct _histogram {
+        uint64_t count = 0;
+        uint64_t total = 0;
+        uint64_t buckets[num_buckets] = {};
+    };
+
+    inline thread_local _histogram histograms[num_phases];
+
+    inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    inline void record(TracePhase phase, uint64_t cycles) {
+        _histogram &h = histograms[static_cast<size_t>(phase)];
+        h.count++;
+        h.total += cycles;
+        size_t k = cycles == 0 ? 0 : 63 - __builtin_clzll(cycles);
+        h.buckets[k < num_buckets ? k : num_buckets - 1]++;
+    }
+
+    class scoped_timer {
+        TracePhase phase;
+        uint64_t start;
+
+    public:
+        explicit scoped_timer(TracePhase phase_) : phase(phase_), start(read_cycles()) {
+        }
+
+        scoped_timer(scoped_timer const &) = delete;
+        scoped_timer &operator=(scoped_timer const &) = delete;
+
+        ~scoped_timer() {
+            record(phase, read_cycles() - start);
+        }
+    };
+
+    inline void trace_reset() {
+        for (auto &h : histograms) {
+            h = _histogram{};
+        }
+    }
+
+    // 打印本线程各阶段的次数、总周期数、占比、均值和耗时分布
+    inline void trace_report(std::ostream &os = std::cout) {
+        static char const *const names[num_phases] = {"whitespace", "string", "number", "container"};
+        uint64_t all = 0;
+        for (auto const &h : histograms) {
+            all += h.total;
+        }
+        for (size_t i = 0; i < num_phases; i++) {
+            _histogram const &h = histograms[i];
+            os << names[i] << ": count " << h.count << ", cycles " << h.total;
+            if (all != 0) {
+                os << " (" << 100.0 * h.total / all << "%)";
+            }
+            if (h.count != 0) {
+                os << ", mean " << double(h.total) / h.count;
+            }
+            os << "\n";
+            for (size_t k = 0; k < num_buckets; k++) {
+                if (h.buckets[k] == 0) {
+                    continue;
+                }
+                os << "  [" << (uint64_t(1) << k) << ", " << (uint64_t(1) << (k + 1)) << "): " << h.buckets[k] << " ";
+                for (uint64_t bar = h.buckets[k] * 50 / h.count; bar > 0; bar--) {
+                    os << '#';
+                }
+                os << "\n";
+            }
+        }
+    }
+}
+
+using _trace_details::trace_reset;
+using _trace_details::trace_report;
+
+#define BABYJSON_TRACE_CONCAT_(a, b) a##b
+#define BABYJSON_TRACE_CONCAT(a, b) BABYJSON_TRACE_CONCAT_(a, b)
+#define BABYJSON_TRACE_SCOPE(phase) ::_trace_details::scoped_timer BABYJSON_TRACE_CONCAT(_trace_timer_, __LINE__)(TracePhase::phase)
+
+#else
+
+#define BABYJSON_TRACE_SCOPE(phase) ((void)0)
+
+#endif
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+namespace _utf8_details {
+    // 查表法 UTF-8 校验，见 Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"
+    // 每个字节对 (prev1, input) 查三张表，三个结果按位与，非零即错误
+    constexpr uint8_t TOO_SHORT = 1 << 0;      // 11______ 0_______ / 11______ 11______
+    constexpr uint8_t TOO_LONG = 1 << 1;       // 0_______ 10______
+    constexpr uint8_t OVERLONG_3 = 1 << 2;     // 11100000 100_____
+    constexpr uint8_t TOO_LARGE = 1 << 3;      // 11110100 1001____ 等
+    constexpr uint8_t SURROGATE = 1 << 4;      // 11101101 101_____
+    constexpr uint8_t OVERLONG_2 = 1 << 5;     // 1100000_ 10______
+    constexpr uint8_t TOO_LARGE_1000 = 1 << 6; // 11110101 1000____ 等
+    constexpr uint8_t OVERLONG_4 = 1 << 6;     // 11110000 1000____
+    constexpr uint8_t TWO_CONTS = 1 << 7;      // 10______ 10______
+    constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+    alignas(16) constexpr uint8_t byte_1_high_table[16] = {
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+    };
+
+    alignas(16) constexpr uint8_t byte_1_low_table[16] = {
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+    };
+
+    alignas(16) constexpr uint8_t byte_2_high_table[16] = {
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    };
+
+    // 块末尾若停在多字节序列中间，下一块必须接上续字节
+    alignas(16) constexpr uint8_t incomplete_max[16] = {
+        255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+    };
+
+    // 返回第一个非法序列的起始下标，全部合法时返回 n
+    inline size_t first_invalid(unsigned char const *s, size_t n) {
+        size_t i = 0;
+        while (i < n) {
+            if (i + 8 <= n) {
+                uint64_t w;
+                std::memcpy(&w, s + i, 8);
+                if ((w & 0x8080808080808080ull) == 0) {
+                    i += 8;
+                    continue;
+                }
+            }
+            unsigned char c = s[i];
+            if (c < 0x80) {
+                i += 1;
+                continue;
+            }
+            size_t len;
+            uint32_t cp;
+            if ((c & 0xE0) == 0xC0) {
+                len = 2;
+                cp = c & 0x1F;
+            } else if ((c & 0xF0) == 0xE0) {
+                len = 3;
+                cp = c & 0x0F;
+            } else if ((c & 0xF8) == 0xF0) {
+                len = 4;
+                cp = c & 0x07;
+            } else {
+                return i;
+            }
+            if (n - i < len) {
+                return i;
+            }
+            for (size_t k = 1; k < len; k++) {
+                if ((s[i + k] & 0xC0) != 0x80) {
+                    return i;
+                }
+                cp = (cp << 6) | (s[i + k] & 0x3F);
+            }
+            if ((len == 2 && cp < 0x80) || (len == 3 && cp < 0x800) || (len == 4 && cp < 0x10000)) {
+                return i;
+            }
+            if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+                return i;
+            }
+            i += len;
+        }
+        return n;
+    }
+
+    inline bool validate_scalar(unsigned char const *s, size_t n) {
+        return first_invalid(s, n) == n;
+    }
+
+#if defined(__AVX2__)
+    struct _simd_checker {
+        using vec = __m256i;
+        static constexpr size_t width = 32;
+
+        vec error = _mm256_setzero_si256();
+        vec prev_input = _mm256_setzero_si256();
+        vec prev_incomplete = _mm256_setzero_si256();
+
+        static vec table(uint8_t const *t) {
+            return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<__m128i const *>(t)));
+        }
+
+        static vec shr4(vec v) {
+            return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+        }
+
+        template <int N>
+        static vec prev(vec input, vec prev_input) {
+            return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev_input, input, 0x21), 16 - N);
+        }
+
+        void check(vec input) {
+            if (_mm256_movemask_epi8(input) == 0) {
+                error = _mm256_or_si256(error, prev_incomplete);
+                prev_incomplete = _mm256_setzero_si256();
+                prev_input = input;
+                return;
+            }
+            vec prev1 = prev<1>(input, prev_input);
+            vec sc = _mm256_and_si256(
+                _mm256_and_si256(_mm256_shuffle_epi8(table(byte_1_high_table), shr4(prev1)),
+                                 _mm256_shuffle_epi8(table(byte_1_low_table), _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+                _mm256_shuffle_epi8(table(byte_2_high_table), shr4(input)));
+            vec must23 = _mm256_or_si256(_mm256_subs_epu8(prev<2>(input, prev_input), _mm256_set1_epi8(char(0xE0 - 0x80))),
+                                         _mm256_subs_epu8(prev<3>(input, prev_input), _mm256_set1_epi8(char(0xF0 - 0x80))));
+            vec must23_80 = _mm256_and_si256(must23, _mm256_set1_epi8(char(0x80)));
+            error = _mm256_or_si256(error, _mm256_xor_si256(must23_80, sc));
+            prev_incomplete = _mm256_subs_epu8(input, _mm256_setr_m128i(_mm_set1_epi8(char(255)),
+                                                                         _mm_load_si128(reinterpret_cast<__m128i const *>(incomplete_max))));
+            prev_input = input;
+        }
+
+        static vec load(unsigned char const *p) {
+            return _mm256_loadu_si256(reinterpret_cast<vec const *>(p));
+        }
+
+        bool finish() {
+            error = _mm256_or_si256(error, prev_incomplete);
+            return _mm256_testz_si256(error, error);
+        }
+    };
+#elif defined(__SSSE3__)
+    struct _simd_checker {
+        using vec = __m128i;
+        static constexpr size_t width = 16;
+
+        vec error = _mm_setzero_si128();
+        vec prev_input = _mm_setzero_si128();
+        vec prev_incomplete = _mm_setzero_si128();
+
+        static vec table(uint8_t const *t) {
+            return _mm_load_si128(reinterpret_cast<__m128i const *>(t));
+        }
+
+        static vec shr4(vec v) {
+            return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+        }
+
+        void check(vec input) {
+            if (_mm_movemask_epi8(input) == 0) {
+                error = _mm_or_si128(error, prev_incomplete);
+                prev_incomplete = _mm_setzero_si128();
+                prev_input = input;
+                return;
+            }
+            vec prev1 = _mm_alignr_epi8(input, prev_input, 15);
+            vec sc = _mm_and_si128(
+                _mm_and_si128(_mm_shuffle_epi8(table(byte_1_high_table), shr4(prev1)),
+                              _mm_shuffle_epi8(table(byte_1_low_table), _mm_and_si128(prev1, _mm_set1_epi8(0x0F)))),
+                _mm_shuffle_epi8(table(byte_2_high_table), shr4(input)));
+            vec must23 = _mm_or_si128(_mm_subs_epu8(_mm_alignr_epi8(input, prev_input, 14), _mm_set1_epi8(char(0xE0 - 0x80))),
+                                      _mm_subs_epu8(_mm_alignr_epi8(input, prev_input, 13), _mm_set1_epi8(char(0xF0 - 0x80))));
+            vec must23_80 = _mm_and_si128(must23, _mm_set1_epi8(char(0x80)));
+            error = _mm_or_si128(error, _mm_xor_si128(must23_80, sc));
+            prev_incomplete = _mm_subs_epu8(input, table(incomplete_max));
+            prev_input = input;
+        }
+
+        static vec load(unsigned char const *p) {
+            return _mm_loadu_si128(reinterpret_cast<vec const *>(p));
+        }
+
+        bool finish() {
+            error = _mm_or_si128(error, prev_incomplete);
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+        }
+    };
+#endif
+
+    // 校验 [data, data + size) 是否为合法 UTF-8（拒绝过长编码、代理区和超过 U+10FFFF 的码点）
+    inline bool utf8_validate(char const *data, size_t size) {
+        auto s = reinterpret_cast<unsigned char const *>(data);
+#if defined(__AVX2__) || defined(__SSSE3__)
+        if (size >= 16) {
+            _simd_checker checker;
+            constexpr size_t W = _simd_checker::width;
+            size_t i = 0;
+            for (; i + W <= size; i += W) {
+                checker.check(_simd_checker::load(s + i));
+            }
+            if (i < size) {
+                alignas(32) unsigned char tail[W] = {};
+                std::memcpy(tail, s + i, size - i);
+                checker.check(_simd_checker::load(tail));
+            }
+            return checker.finish();
+        }
+#endif
+        return validate_scalar(s, size);
+    }
+
+    inline bool utf8_validate(std::string_view str) {
+        return utf8_validate(str.data(), str.size());
+    }
+
+    // 标量地找出第一个非法序列的位置，用于出错后报告偏移，合法时返回 str.size()
+    inline size_t utf8_first_invalid(std::string_view str) {
+        return first_invalid(reinterpret_cast<unsigned char const *>(str.data()), str.size());
+    }
+}
+
+using _utf8_details::utf8_validate;
+using _utf8_details::utf8_first_invalid;